@@ -1,124 +1,282 @@
 #pragma once
 
-#include "document.h"
-#include "search_server.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
 
-using namespace std::string_literals;
-
-
-template <typename Key, typename Value>
+// Потокобезопасная хеш-таблица, разбитая на шарды.
+// Шард - отдельная таблица с открытой адресацией (линейное пробирование,
+// удаление сдвигом назад без tombstone) под собственным shared_mutex:
+// чтения одного шарда выполняются параллельно, запись блокирует только свой шард.
+// Таблица не lock-free: и чтение, и запись берут мьютекс шарда. Оптимистичное
+// чтение без блокировки копировало бы значение произвольного типа, пока запись
+// перемещает слоты, - это гонка данных.
+// Шарды выровнены по кеш-линии, чтобы соседние мьютексы не делили одну линию.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class ConcurrentMap {
-    friend class SearchServer;
 private:
-    struct Bucket {
-        std::mutex mutex;
-        std::map<Key, Value> map;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t INITIAL_SHARD_CAPACITY = 8;
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::shared_mutex mutex;
+        std::vector<std::optional<std::pair<Key, Value>>> slots;
+        size_t size = 0;
     };
+
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+    static constexpr size_t DEFAULT_SHARD_COUNT = 64;
 
+    // Ссылка на значение, шард заблокирован на запись до разрушения Access.
+    // Не стоит держать два Access одновременно в одном потоке - ключи могут попасть в один шард.
     struct Access {
-        std::scoped_lock<std::mutex> guard;
+        std::unique_lock<std::shared_mutex> guard;
         Value& ref_to_value;
-
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.map[key])
-        {}
     };
-    explicit ConcurrentMap(size_t bucket_count)
-        : bucket_(bucket_count)
-    {}
+
+    // Число шардов округляется вверх до степени двойки
+    explicit ConcurrentMap(size_t shard_count = DEFAULT_SHARD_COUNT, const Hash& hash = Hash())
+        : hash_(hash)
+    {
+        size_t count = 1;
+        while (count < shard_count) {
+            count *= 2;
+            ++shard_bits_;
+        }
+        _shards_ = std::vector<Shard>(count);
+        for (Shard& shard : _shards_) {
+            shard.slots.resize(INITIAL_SHARD_CAPACITY);
+        }
+    }
+
+    // Значение по ключу, при отсутствии вставляется Value()
     Access operator[](const Key& key) {
-       auto* bucket = &bucket_[static_cast<uint64_t>(key) % bucket_.size()];
-        return {key, *bucket};
+        const uint64_t hash = HashOf(key);
+        Shard& shard = GetShard(hash);
+        std::unique_lock guard(shard.mutex);
+        return {std::move(guard), FindOrInsert(shard, key, hash).second};
     }
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (auto& [mutex, map] : bucket_) {
-            std::lock_guard guard(mutex);
-            result.insert(map.begin(), map.end());
+
+    // false, если ключ уже был; существующее значение не меняется
+    bool Insert(const Key& key, Value value) {
+        const uint64_t hash = HashOf(key);
+        Shard& shard = GetShard(hash);
+        std::unique_lock guard(shard.mutex);
+        const size_t size = shard.size;
+        auto& entry = FindOrInsert(shard, key, hash);
+        if (shard.size == size) {
+            return false;
+        }
+        entry.second = std::move(value);
+        return true;
+    }
+
+    // Копия значения, если ключ есть
+    std::optional<Value> Find(const Key& key) const {
+        const uint64_t hash = HashOf(key);
+        const Shard& shard = GetShard(hash);
+        std::shared_lock guard(shard.mutex);
+        const auto& slot = shard.slots[FindSlot(shard, key, hash)];
+        if (!slot) {
+            return std::nullopt;
+        }
+        return slot->second;
+    }
+
+    bool Contains(const Key& key) const {
+        const uint64_t hash = HashOf(key);
+        const Shard& shard = GetShard(hash);
+        std::shared_lock guard(shard.mutex);
+        return shard.slots[FindSlot(shard, key, hash)].has_value();
+    }
+
+    bool Erase(const Key& key) {
+        const uint64_t hash = HashOf(key);
+        Shard& shard = GetShard(hash);
+        std::unique_lock guard(shard.mutex);
+        size_t index = FindSlot(shard, key, hash);
+        if (!shard.slots[index]) {
+            return false;
+        }
+        // Сдвигаем назад записи цепочки, которые иначе стали бы недостижимы
+        const size_t mask = shard.slots.size() - 1;
+        shard.slots[index].reset();
+        for (size_t next = (index + 1) & mask; shard.slots[next]; next = (next + 1) & mask) {
+            const size_t home = SlotIndex(HashOf(shard.slots[next]->first), mask);
+            const bool home_in_gap = index < next ? (index < home && home <= next)
+                                                  : (index < home || home <= next);
+            if (!home_in_gap) {
+                shard.slots[index] = std::move(shard.slots[next]);
+                shard.slots[next].reset();
+                index = next;
+            }
+        }
+        --shard.size;
+        return true;
+    }
+
+    // Не атомарен относительно параллельных изменений в разных шардах
+    size_t size() const {
+        size_t result = 0;
+        for (const Shard& shard : _shards_) {
+            std::shared_lock guard(shard.mutex);
+            result += shard.size;
         }
         return result;
     }
-    void Erase(Key key) {
-        auto* it = &bucket_.operator[](key);
-        std::lock_guard guard((*it).mutex);
-        (*it).map.erase(key);
+
+    void Clear() {
+        for (Shard& shard : _shards_) {
+            std::unique_lock guard(shard.mutex);
+            shard.slots.assign(INITIAL_SHARD_CAPACITY, std::nullopt);
+            shard.size = 0;
+        }
     }
-private:
-    std::vector<Bucket> bucket_;
-};
 
+    // function(key, value) для всех записей, шарды обходятся по одному под блокировкой на чтение
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const Shard& shard : _shards_) {
+            std::shared_lock guard(shard.mutex);
+            for (const auto& slot : shard.slots) {
+                if (slot) {
+                    function(slot->first, slot->second);
+                }
+            }
+        }
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        std::map<Key, Value> result;
+        ForEach([&result](const Key& key, const Value& value) {
+            result.emplace(key, value);
+        });
+        return result;
+    }
 
-// not test
-template <typename Key, typename Value>
-class ConcurrentSet {
 private:
-    struct Bucket {
-        std::mutex mutex;
-        std::set<Key> set;
-    };
-public:
-    //static_assert(std::is_integral_v<Key>, "ConcurrentSet supports only integer keys");
-    static_assert(std::is_same<typename std::remove_cv<Key>::type, Key>::value,
-    "std::set must have a non-const, non-volatile value_type");
-    struct Access {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
+    Hash hash_;
+    size_t shard_bits_ = 0;
+    std::vector<Shard> _shards_;
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.set[key])
-        {}
-    };
+    // Перемешивание (финализатор MurmurHash3): std::hash для целых - тождественная функция
+    uint64_t HashOf(const Key& key) const {
+        uint64_t hash = static_cast<uint64_t>(hash_(key));
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
 
-    explicit ConcurrentSet(size_t bucket_count)
-        : bucket_(bucket_count)
-    {}
+    // Младшие биты хеша выбирают шард, следующие - слот внутри шарда
+    Shard& GetShard(uint64_t hash) {
+        return _shards_[hash & (_shards_.size() - 1)];
+    }
+    const Shard& GetShard(uint64_t hash) const {
+        return _shards_[hash & (_shards_.size() - 1)];
+    }
+    size_t SlotIndex(uint64_t hash, size_t mask) const {
+        return static_cast<size_t>(hash >> shard_bits_) & mask;
+    }
 
-    Access operator[](const Key& key) {
-        auto& bucket = bucket_[key];
-        return {key, bucket};
+    // Слот с ключом или первый пустой слот цепочки
+    size_t FindSlot(const Shard& shard, const Key& key, uint64_t hash) const {
+        const size_t mask = shard.slots.size() - 1;
+        size_t index = SlotIndex(hash, mask);
+        while (shard.slots[index] && !(shard.slots[index]->first == key)) {
+            index = (index + 1) & mask;
+        }
+        return index;
     }
 
-    std::set<Key> BuildOrdinarySet() {
-        std::set<Key> result;
-        for (auto& [mutex, set] : bucket_) {
-            std::lock_guard guard(mutex);
-            result.insert(set.begin(), set.end());
+    std::pair<Key, Value>& FindOrInsert(Shard& shard, const Key& key, uint64_t hash) {
+        size_t index = FindSlot(shard, key, hash);
+        if (!shard.slots[index]) {
+            // Коэффициент заполнения не выше 1/2
+            if (2 * (shard.size + 1) > shard.slots.size()) {
+                Grow(shard);
+                index = FindSlot(shard, key, hash);
+            }
+            shard.slots[index].emplace(key, Value());
+            ++shard.size;
         }
-        return result;       
+        return *shard.slots[index];
     }
 
-    std::set<unsigned long>::iterator begin() {
-        return bucket_.begin();
+    void Grow(Shard& shard) {
+        std::vector<std::optional<std::pair<Key, Value>>> old_slots(shard.slots.size() * 2);
+        old_slots.swap(shard.slots);
+        const size_t mask = shard.slots.size() - 1;
+        for (auto& old_slot : old_slots) {
+            if (old_slot) {
+                size_t index = SlotIndex(HashOf(old_slot->first), mask);
+                while (shard.slots[index]) {
+                    index = (index + 1) & mask;
+                }
+                shard.slots[index] = std::move(old_slot);
+            }
+        }
+    }
+};
+
+
+// Потокобезопасное множество поверх ConcurrentMap
+template <typename Key, typename Hash = std::hash<Key>>
+class ConcurrentSet {
+private:
+    struct Empty {};
+
+public:
+    explicit ConcurrentSet(size_t shard_count = ConcurrentMap<Key, Empty, Hash>::DEFAULT_SHARD_COUNT,
+                           const Hash& hash = Hash())
+        : map_(shard_count, hash)
+    {}
+
+    // false, если ключ уже был в множестве
+    bool Insert(const Key& key) {
+        return map_.Insert(key, Empty{});
     }
 
-    std::set<unsigned long>::iterator end() {
-        return bucket_.end();
+    bool Contains(const Key& key) const {
+        return map_.Contains(key);
     }
 
-    const std::set<unsigned long>::iterator cbegin() {
-        return bucket_.begin();
+    bool Erase(const Key& key) {
+        return map_.Erase(key);
     }
 
-    const std::set<unsigned long>::iterator cend() {
-        return bucket_.end();
+    size_t size() const {
+        return map_.size();
     }
 
-    size_t size(const Key& key) {
-        auto& bucket = bucket_[key];
-        return bucket.set.size();
+    void Clear() {
+        map_.Clear();
     }
 
-    void Erase(const Key& key) {
-        auto& bucket = bucket_[key];
-        std::lock_guard guard(bucket.mutex);
-        bucket.set.erase(key);
+    template <typename Function>
+    void ForEach(Function function) const {
+        map_.ForEach([&function](const Key& key, const Empty&) {
+            function(key);
+        });
     }
 
-private:
-    std::vector<Bucket> bucket_;
+    std::set<Key> BuildOrdinarySet() const {
+        std::set<Key> result;
+        ForEach([&result](const Key& key) {
+            result.insert(key);
+        });
+        return result;
+    }
 
+private:
+    ConcurrentMap<Key, Empty, Hash> map_;
 };
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+#include "concurrent_search_server.h"
+
+using namespace std;
+
+DeletedDocuments DeletedDocuments::With(int document_id, IteratorRange<ForwardIndex::TermIterator> terms,
+                                        int64_t word_count) const {
+    DeletedDocuments result = *this;        // копируются только указатели
+
+    const uint32_t key = static_cast<uint32_t>(document_id) >> CHUNK_BITS;
+    const auto it = std::lower_bound(result._chunk_keys_.begin(), result._chunk_keys_.end(), key);
+    const size_t index = it - result._chunk_keys_.begin();
+    DocumentBitmap chunk;
+    if (it != result._chunk_keys_.end() && *it == key) {
+        chunk = *result._chunks_[index];
+    } else {
+        result._chunk_keys_.insert(it, key);
+        result._chunks_.insert(result._chunks_.begin() + index, nullptr);
+    }
+    chunk.Add(document_id);
+    result._chunks_[index] = std::make_shared<const DocumentBitmap>(std::move(chunk));
+    ++result.count_;
+    result.word_count_ += word_count;
+
+    auto level = std::make_shared<TermCounts>();
+    level->reserve(terms.size());
+    for (const TermId term_id : terms) {
+        level->emplace_back(term_id, 1);
+    }
+    auto& _levels = result._term_count_levels_;
+    // Сливаются последние уровни, пока предпоследний не станет больше чем вдвое длиннее последнего
+    while (!_levels.empty() && _levels.back()->size() <= 2 * level->size()) {
+        const TermCounts& lhs = *_levels.back();
+        auto merged = std::make_shared<TermCounts>();
+        merged->reserve(lhs.size() + level->size());
+        auto left = lhs.begin();
+        auto right = level->begin();
+        while (left != lhs.end() && right != level->end()) {
+            if (left->first < right->first) {
+                merged->push_back(*left++);
+            } else if (right->first < left->first) {
+                merged->push_back(*right++);
+            } else {
+                merged->emplace_back(left->first, left->second + right->second);
+                ++left;
+                ++right;
+            }
+        }
+        merged->insert(merged->end(), left, lhs.end());
+        merged->insert(merged->end(), right, level->end());
+        _levels.pop_back();
+        level = std::move(merged);
+    }
+    _levels.push_back(std::move(level));
+    return result;
+}
+
+uint32_t DeletedDocuments::GetTermCount(TermId term_id) const {
+    uint32_t count = 0;
+    for (const auto& level : _term_count_levels_) {
+        const auto it = std::lower_bound(level->begin(), level->end(), term_id,
+                                         [](const std::pair<TermId, uint32_t>& term_count, TermId id) {
+                                             return term_count.first < id;
+                                         });
+        if (it != level->end() && it->first == term_id) {
+            count += it->second;
+        }
+    }
+    return count;
+}
+
+
+SearchServerSnapshot::SearchServerSnapshot(std::vector<IndexSegment> segments)
+    : _segments_(std::move(segments))
+{
+    for (const IndexSegment& segment : _segments_) {
+        document_count_ += segment.GetDocumentCount();
+        word_count_ += segment.index->word_count_ - (segment.deleted ? segment.deleted->GetWordCount() : 0);
+    }
+}
+
+std::vector<Document>
+SearchServerSnapshot::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(raw_query, DocumentAttributeFilter{status}, top_count);
+}
+
+std::vector<Document>
+SearchServerSnapshot::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+int SearchServerSnapshot::GetDocumentCount() const {
+    return document_count_;
+}
+
+size_t SearchServerSnapshot::GetSegmentCount() const {
+    return _segments_.size();
+}
+
+DocumentsByStatus
+SearchServerSnapshot::MatchDocument(std::string_view raw_query, int document_id) const {
+    return GetSegment(document_id).MatchDocument(raw_query, document_id);
+}
+
+std::map<std::string_view, double> SearchServerSnapshot::GetWordFrequencies(int document_id) const {
+    return GetSegment(document_id).GetWordFrequencies(document_id);
+}
+
+TermFrequencies SearchServerSnapshot::GetTermFrequencies(int document_id) const {
+    return GetSegment(document_id).GetTermFrequencies(document_id);
+}
+
+const SearchServer& SearchServerSnapshot::GetSegment(int document_id) const {
+    for (const IndexSegment& segment : _segments_) {
+        if (segment.index->_ordinals_.Contains(document_id) && !segment.IsDeleted(document_id)) {
+            return *segment.index;
+        }
+    }
+    throw std::out_of_range("Id doesn't exist"s);
+}
+
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string_view stopwords_text)
+    : ConcurrentSearchServer(SearchServer(stopwords_text))
+{}
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string& stopwords_text)
+    : ConcurrentSearchServer(SearchServer(stopwords_text))
+{}
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer&& empty_segment)
+    : empty_segment_(std::make_shared<const SearchServer>(std::move(empty_segment)))
+    , delta_(*empty_segment_)
+{
+    Publish();
+    merge_thread_ = std::thread([this] { RunMerges(); });
+}
+
+ConcurrentSearchServer::~ConcurrentSearchServer() {
+    {
+        std::lock_guard guard(mutex_);
+        stop_ = true;
+    }
+    merge_condition_.notify_one();
+    merge_thread_.join();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, const std::string_view document,
+                                         DocumentStatus status, const std::vector<int>& ratings) {
+    std::lock_guard guard(mutex_);
+    if (HasDocument(document_id)) {
+        throw invalid_argument("This id exist already"s);
+    }
+    delta_.AddDocument(document_id, document, status, ratings);
+    published_delta_ = nullptr;
+    if (delta_.GetDocumentCount() >= DELTA_CHUNK_LIMIT) {
+        _delta_chunks_.push_back({std::make_shared<const SearchServer>(std::move(delta_)), nullptr});
+        delta_ = *empty_segment_;
+        if (_delta_chunks_.size() * DELTA_CHUNK_LIMIT >= DELTA_DOCUMENT_LIMIT) {
+            FreezeDelta();
+        }
+    }
+    Publish();
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    std::lock_guard guard(mutex_);
+    if (delta_._ordinals_.Contains(document_id)) {
+        delta_.RemoveDocument(document_id);
+        published_delta_ = nullptr;
+        Publish();
+        return;
+    }
+    for (auto* _segments : {&_delta_chunks_, &_segments_}) {
+        for (IndexSegment& segment : *_segments) {
+            if (segment.index->_ordinals_.Contains(document_id) && !segment.IsDeleted(document_id)) {
+                segment.deleted = AddDeleted(*segment.index, segment.deleted.get(), document_id);
+                merge_condition_.notify_one();
+                Publish();
+                return;
+            }
+        }
+    }
+    throw std::out_of_range("Id doesn't exist"s);
+}
+
+std::shared_ptr<const SearchServerSnapshot> ConcurrentSearchServer::GetSnapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+std::vector<Document>
+ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+    return GetSnapshot()->FindTopDocuments(raw_query, status, top_count);
+}
+
+std::vector<Document>
+ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return GetSnapshot()->FindTopDocuments(raw_query);
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return GetSnapshot()->GetDocumentCount();
+}
+
+//private
+
+void ConcurrentSearchServer::Publish() {
+    if (!published_delta_ && delta_.GetDocumentCount() > 0) {
+        published_delta_ = std::make_shared<const SearchServer>(delta_);
+    }
+    std::vector<IndexSegment> segments;
+    segments.reserve(_segments_.size() + _delta_chunks_.size() + 1);
+    segments.insert(segments.end(), _segments_.begin(), _segments_.end());
+    segments.insert(segments.end(), _delta_chunks_.begin(), _delta_chunks_.end());
+    if (published_delta_) {
+        segments.push_back({published_delta_, nullptr});
+    }
+    if (segments.empty()) {
+        segments.push_back({empty_segment_, nullptr});
+    }
+    std::atomic_store(&snapshot_, std::make_shared<const SearchServerSnapshot>(std::move(segments)));
+}
+
+bool ConcurrentSearchServer::HasDocument(int document_id) const {
+    const auto contains = [document_id](const IndexSegment& segment) {
+        return segment.index->_ordinals_.Contains(document_id) && !segment.IsDeleted(document_id);
+    };
+    return delta_._ordinals_.Contains(document_id)
+        || any_of(_delta_chunks_.begin(), _delta_chunks_.end(), contains)
+        || any_of(_segments_.begin(), _segments_.end(), contains);
+}
+
+void ConcurrentSearchServer::FreezeDelta() {
+    auto merged = std::make_shared<SearchServer>(*empty_segment_);
+    for (const IndexSegment& chunk : _delta_chunks_) {
+        merged->MergeFrom(*chunk.index, [&chunk](int document_id) { return !chunk.IsDeleted(document_id); });
+    }
+    _delta_chunks_.clear();
+    if (merged->GetDocumentCount() > 0) {
+        _segments_.push_back({std::move(merged), nullptr});
+        merge_condition_.notify_one();
+    }
+}
+
+std::vector<size_t> ConcurrentSearchServer::SelectMerge() const {
+    // Уровень сегмента: t, если в нём [DELTA_DOCUMENT_LIMIT * MERGE_FACTOR^t, ... * MERGE_FACTOR^(t+1)) документов
+    std::map<int, std::vector<size_t>> _tier_to_segments;
+    for (size_t i = 0; i < _segments_.size(); ++i) {
+        const IndexSegment& segment = _segments_[i];
+        // Сегмент, в котором удалена большая часть документов, переписывается отдельно
+        if (segment.deleted && 2 * segment.deleted->GetCount() > segment.index->GetDocumentCount()) {
+            return {i};
+        }
+        int tier = 0;
+        for (int64_t limit = int64_t{DELTA_DOCUMENT_LIMIT} * MERGE_FACTOR;
+             segment.GetDocumentCount() >= limit; limit *= MERGE_FACTOR) {
+            ++tier;
+        }
+        _tier_to_segments[tier].push_back(i);
+    }
+    for (auto& [tier, _indexes] : _tier_to_segments) {
+        if (_indexes.size() >= MERGE_FACTOR) {
+            _indexes.resize(MERGE_FACTOR);
+            return _indexes;
+        }
+    }
+    return {};
+}
+
+void ConcurrentSearchServer::RunMerges() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        std::vector<size_t> _merge_indexes;
+        merge_condition_.wait(lock, [this, &_merge_indexes] {
+            return stop_ || !(_merge_indexes = SelectMerge()).empty();
+        });
+        if (stop_) {
+            return;
+        }
+        std::vector<IndexSegment> inputs;
+        for (const size_t index : _merge_indexes) {
+            inputs.push_back(_segments_[index]);
+        }
+
+        // Слияние без блокировки: входные сегменты неизменяемы, а удаления,
+        // сделанные за это время, переносятся в новый сегмент ниже
+        lock.unlock();
+        std::shared_ptr<SearchServer> merged;
+        try {
+            merged = std::make_shared<SearchServer>(*empty_segment_);
+            for (const IndexSegment& input : inputs) {
+                merged->MergeFrom(*input.index, [&input](int document_id) { return !input.IsDeleted(document_id); });
+            }
+        } catch (const std::exception& e) {
+            // Входные сегменты остаются на месте; следующая попытка - после следующего изменения
+            lock.lock();
+            std::cerr << "Segment merge failed: "s << e.what() << std::endl;
+            if (!stop_) {
+                merge_condition_.wait(lock);
+            }
+            continue;
+        }
+        lock.lock();
+
+        std::shared_ptr<const DeletedDocuments> deleted;
+        size_t position = _segments_.size();
+        for (const IndexSegment& input : inputs) {
+            const auto it = find_if(_segments_.begin(), _segments_.end(),
+                                    [&input](const IndexSegment& segment) { return segment.index == input.index; });
+            position = min<size_t>(position, it - _segments_.begin());
+            if (it->deleted != input.deleted) {
+                for (const int document_id : input.index->_ordinals_) {
+                    if (it->IsDeleted(document_id) && !input.IsDeleted(document_id)) {
+                        deleted = AddDeleted(*merged, deleted.get(), document_id);
+                    }
+                }
+            }
+            _segments_.erase(it);
+        }
+        if (merged->GetDocumentCount() > 0) {
+            _segments_.insert(_segments_.begin() + position, {std::move(merged), std::move(deleted)});
+        }
+        Publish();
+    }
+}
+
+std::shared_ptr<const DeletedDocuments> ConcurrentSearchServer::AddDeleted(const SearchServer& segment,
+                                                                           const DeletedDocuments* deleted,
+                                                                           int document_id) {
+    const SearchServer::Ordinal ordinal = segment.GetOrdinal(document_id);
+    return std::make_shared<const DeletedDocuments>(
+        (deleted ? *deleted : DeletedDocuments{}).With(document_id, segment._forward_index_.GetTerms(ordinal),
+                                                       static_cast<int64_t>(segment._ordinal_to_norms_[ordinal].word_count)));
+}
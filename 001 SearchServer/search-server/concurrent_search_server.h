@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "document_bitmap.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+// Удалённые документы сегмента (tombstones). Удалённый документ остаётся
+// в индексе сегмента до ближайшего слияния, но не попадает в выдачу
+// и не учитывается в статистике слов.
+// Набор неизменяем и разделяется снимками; удаление создаёт новый набор (With),
+// который копирует у старого только затронутое. Id хранятся группами по 2^16
+// (DocumentBitmap на группу), поэтому копируется одна группа, а не карта на весь
+// диапазон id сегмента. Числа удалённых документов по словам - уровни отсортированных
+// пар (id слова, число), которые сливаются как разряды двоичного счётчика: удаление
+// переписывает в среднем O(log) уровней от слов документа, а не весь словарь сегмента.
+class DeletedDocuments
+{
+public:
+    using TermId = TermDictionary::TermId;
+
+    // Набор с ещё одним удалённым документом: document_id, id его слов по возрастанию
+    // и число его слов
+    DeletedDocuments With(int document_id, IteratorRange<ForwardIndex::TermIterator> terms,
+                          int64_t word_count) const;
+
+    bool Contains(int document_id) const {
+        const uint32_t key = static_cast<uint32_t>(document_id) >> CHUNK_BITS;
+        const auto it = std::lower_bound(_chunk_keys_.begin(), _chunk_keys_.end(), key);
+        return it != _chunk_keys_.end() && *it == key && _chunks_[it - _chunk_keys_.begin()]->Contains(document_id);
+    }
+
+    // Число удалённых документов со словом term_id
+    uint32_t GetTermCount(TermId term_id) const;
+
+    int GetCount() const {
+        return count_;
+    }
+
+    // Сумма длин удалённых документов
+    int64_t GetWordCount() const {
+        return word_count_;
+    }
+
+private:
+    static constexpr int CHUNK_BITS = 16;
+
+    using TermCounts = std::vector<std::pair<TermId, uint32_t>>;
+
+    std::vector<uint32_t> _chunk_keys_;                             // id >> CHUNK_BITS, по возрастанию
+    std::vector<std::shared_ptr<const DocumentBitmap>> _chunks_;    // группа _chunk_keys_[i]
+    // Каждый уровень больше чем вдвое длиннее следующего, поэтому уровней O(log)
+    std::vector<std::shared_ptr<const TermCounts>> _term_count_levels_;
+    int count_ = 0;
+    int64_t word_count_ = 0;
+};
+
+// Неизменяемый сегмент индекса вместе с его удалёнными документами
+struct IndexSegment {
+    std::shared_ptr<const SearchServer> index;
+    std::shared_ptr<const DeletedDocuments> deleted;    // nullptr, если удалённых нет
+
+    bool IsDeleted(int document_id) const {
+        return deleted && deleted->Contains(document_id);
+    }
+
+    // Без удалённых
+    int GetDocumentCount() const {
+        return index->GetDocumentCount() - (deleted ? deleted->GetCount() : 0);
+    }
+};
+
+// Неизменяемый снимок индекса ConcurrentSearchServer - набор сегментов,
+// которые ранжируются по общей статистике: IDF слова и нормы длины модели
+// ранжирования считаются по неудалённым документам всех сегментов.
+// Снимок можно читать из любого числа потоков, пока на него есть ссылка.
+class SearchServerSnapshot
+{
+public:
+    // segments не пуст, неудалённые документы сегментов имеют различные id
+    explicit SearchServerSnapshot(std::vector<IndexSegment> segments);
+
+    template <typename RankingModel = TfIdfRanking, typename DocumentPredicate>
+    std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetSegmentCount() const;
+
+    // Слова результата ссылаются на словари снимка
+    DocumentsByStatus
+    MatchDocument(std::string_view raw_query, int document_id) const;
+
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    TermFrequencies GetTermFrequencies(int document_id) const;
+
+private:
+    std::vector<IndexSegment> _segments_;
+    int document_count_ = 0;
+    int64_t word_count_ = 0;
+
+    // Сегмент с неудалённым документом document_id, исключение out_of_range при отсутствии
+    const SearchServer& GetSegment(int document_id) const;
+};
+
+// Поисковый сервер, допускающий запросы одновременно с AddDocument/RemoveDocument.
+// Запросы выполняются над неизменяемым снимком индекса (RCU): снимок публикуется
+// атомарно и живёт, пока на него ссылается хотя бы один читатель, поэтому
+// запросы не ждут писателей. Изменения выполняются по одному.
+//
+// Индекс устроен как LSM: новые документы попадают в небольшой изменяемый
+// хвост дельты, заполненный хвост (DELTA_CHUNK_LIMIT документов) становится
+// неизменяемым куском дельты, а DELTA_DOCUMENT_LIMIT / DELTA_CHUNK_LIMIT кусков
+// сливаются в замороженный сегмент. Публикация снимка копирует только хвост,
+// остальные сегменты разделяются по указателю.
+// Фоновый поток сливает сегменты близкого размера по MERGE_FACTOR штук (tiered),
+// поэтому сегментов O(MERGE_FACTOR * log N), а каждый документ переписывается
+// O(log N) раз. RemoveDocument для замороженного сегмента или куска дельты отмечает
+// документ в наборе удалённых, место освобождается при слиянии.
+class ConcurrentSearchServer
+{
+public:
+    static constexpr int DELTA_DOCUMENT_LIMIT = 64;
+    static constexpr int DELTA_CHUNK_LIMIT = 8;
+    static constexpr size_t MERGE_FACTOR = 8;
+
+    template <typename StringContainer>
+    explicit ConcurrentSearchServer(const StringContainer& stop_words);
+    explicit ConcurrentSearchServer(std::string_view stopwords_text);
+    explicit ConcurrentSearchServer(const std::string& stopwords_text);
+
+    ~ConcurrentSearchServer();
+
+    void AddDocument(int document_id, std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    // Последний опубликованный снимок, последующие изменения на него не влияют
+    std::shared_ptr<const SearchServerSnapshot> GetSnapshot() const;
+
+    // Запросы к последнему опубликованному снимку
+    template <typename RankingModel = TfIdfRanking, typename DocumentPredicate>
+    std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document>
+    FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+private:
+    const std::shared_ptr<const SearchServer> empty_segment_;  // пустой индекс со стоп-словами
+
+    // Защищает сегменты, дельту и публикацию снимков
+    std::mutex mutex_;
+    std::vector<IndexSegment> _segments_;           // замороженные сегменты
+    std::vector<IndexSegment> _delta_chunks_;       // заполненные куски дельты
+    SearchServer delta_;                            // хвост дельты
+    std::shared_ptr<const SearchServer> published_delta_;  // копия хвоста в снимке, nullptr - устарела
+    std::condition_variable merge_condition_;
+    bool stop_ = false;
+
+    std::shared_ptr<const SearchServerSnapshot> snapshot_;  // доступ через std::atomic_load/atomic_store
+
+    std::thread merge_thread_;              // запускается последним
+
+    explicit ConcurrentSearchServer(SearchServer&& empty_segment);
+
+    // Вызываются под mutex_
+    void Publish();
+    bool HasDocument(int document_id) const;
+    // Сливает куски дельты в замороженный сегмент
+    void FreezeDelta();
+    // Индексы сегментов для следующего слияния, пусто - сливать нечего
+    std::vector<size_t> SelectMerge() const;
+
+    // Тело фонового потока слияний
+    void RunMerges();
+
+    // deleted (может быть nullptr) с добавленным документом document_id сегмента segment
+    static std::shared_ptr<const DeletedDocuments> AddDeleted(const SearchServer& segment,
+                                                              const DeletedDocuments* deleted,
+                                                              int document_id);
+};
+
+template <typename RankingModel, typename DocumentPredicate>
+std::vector<Document>
+SearchServerSnapshot::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                       size_t top_count) const {
+
+    // Стоп-слова у всех сегментов общие
+    const SearchServer::QueryWords query_words = _segments_.front().index->ParseQueryWords(raw_query);
+
+    std::vector<SearchServer::Query> queries;
+    queries.reserve(_segments_.size());
+    std::map<std::string_view, size_t> _word_to_document_count;    // по всем сегментам
+    for (const IndexSegment& segment : _segments_) {
+        const SearchServer& index = *segment.index;
+        queries.push_back(index.MapQueryWords(query_words));
+        for (const auto term_id : queries.back().plus_terms) {
+            _word_to_document_count[index._dictionary_.GetTerm(term_id)] +=
+                index._term_to_postings_[term_id].size()
+                - (segment.deleted ? segment.deleted->GetTermCount(term_id) : 0);
+        }
+    }
+
+    const RankingModel ranking_model(CorpusStatistics{document_count_, word_count_});
+    TopDocuments top(top_count);
+    for (size_t i = 0; i < _segments_.size(); ++i) {
+        const IndexSegment& segment = _segments_[i];
+        const SearchServer::Query& query = queries[i];
+        std::vector<double> plus_idf(query.plus_terms.size(), 0.0);
+        for (size_t j = 0; j < query.plus_terms.size(); ++j) {
+            const size_t word_document_count =
+                _word_to_document_count.at(segment.index->_dictionary_.GetTerm(query.plus_terms[j]));
+            if (word_document_count > 0) {
+                plus_idf[j] = SearchServer::ComputeInverseDocumentFreq(document_count_, word_document_count);
+            }
+        }
+        const std::vector<Document> segment_documents = segment.deleted
+            ? segment.index->RankDocuments(std::execution::seq, query, plus_idf, ranking_model,
+                                           [&segment, &document_predicate](int document_id, DocumentStatus status,
+                                                                           int rating) {
+                                               return !segment.deleted->Contains(document_id)
+                                                   && document_predicate(document_id, status, rating);
+                                           },
+                                           top_count)
+            : segment.index->RankDocuments(std::execution::seq, query, plus_idf, ranking_model,
+                                           document_predicate, top_count);
+        for (const Document& document : segment_documents) {
+            top.Push(document);
+        }
+    }
+    return std::move(top).Extract();
+}
+
+template <typename StringContainer>
+ConcurrentSearchServer::ConcurrentSearchServer(const StringContainer& stop_words)
+    : ConcurrentSearchServer(SearchServer(stop_words))
+{}
+
+template <typename RankingModel, typename DocumentPredicate>
+std::vector<Document>
+ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                         size_t top_count) const {
+    return GetSnapshot()->FindTopDocuments<RankingModel>(raw_query, document_predicate, top_count);
+}
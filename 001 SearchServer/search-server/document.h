@@ -1,6 +1,9 @@
 #pragma once
 
+#include <limits>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct Document {
@@ -25,6 +28,26 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Документ для SearchServer::AddDocuments, поля - аргументы AddDocument
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Фильтр по статусу и диапазону рейтинга [min_rating, max_rating], годится как предикат
+// FindTopDocuments. SearchServer проверяет предикаты до подсчёта релевантности документа
+struct DocumentAttributeFilter {
+    std::optional<DocumentStatus> status;   // не задан - любой статус
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+
+    bool operator()(int, DocumentStatus document_status, int rating) const {
+        return (!status || *status == document_status) && min_rating <= rating && rating <= max_rating;
+    }
+};
+
 std::ostream& operator<<(std::ostream& out, const Document& document);
 
 void PrintDocument(const Document& document);
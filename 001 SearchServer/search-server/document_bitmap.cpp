@@ -0,0 +1,81 @@
+#include "document_bitmap.h"
+
+using namespace std;
+
+void DocumentBitmap::Add(int document_id) {
+    const uint32_t key = static_cast<uint32_t>(document_id) >> 16;
+    auto it = _keys_.end();
+    if (_keys_.empty() || _keys_.back() < key) {
+        _keys_.push_back(key);
+        _containers_.emplace_back();
+        it = _keys_.end() - 1;
+    } else if (_keys_.back() != key) {
+        it = lower_bound(_keys_.begin(), _keys_.end(), key);
+        if (*it != key) {
+            _containers_.emplace(_containers_.begin() + (it - _keys_.begin()));
+            it = _keys_.insert(it, key);
+        }
+    } else {
+        it = _keys_.end() - 1;
+    }
+    size_ += _containers_[it - _keys_.begin()].Add(static_cast<uint16_t>(document_id));
+}
+
+void DocumentBitmap::Remove(int document_id) {
+    const uint32_t key = static_cast<uint32_t>(document_id) >> 16;
+    const auto it = lower_bound(_keys_.begin(), _keys_.end(), key);
+    if (it == _keys_.end() || *it != key) {
+        return;
+    }
+    const auto container = _containers_.begin() + (it - _keys_.begin());
+    size_ -= container->Remove(static_cast<uint16_t>(document_id));
+    if (container->_bits_.empty() && container->_values_.empty()) {
+        _containers_.erase(container);
+        _keys_.erase(it);
+    }
+}
+
+bool DocumentBitmap::Container::Add(uint16_t value) {
+    if (!_bits_.empty()) {
+        uint64_t& word = _bits_[value >> 6];
+        const uint64_t bit = uint64_t{1} << (value & 63);
+        const bool is_new = (word & bit) == 0;
+        word |= bit;
+        return is_new;
+    }
+    if (_values_.empty() || _values_.back() < value) {
+        _values_.push_back(value);
+    } else {
+        const auto it = lower_bound(_values_.begin(), _values_.end(), value);
+        if (*it == value) {
+            return false;
+        }
+        _values_.insert(it, value);
+    }
+    // Массив больше ARRAY_LIMIT значений занимает больше места, чем битовая карта
+    if (_values_.size() > ARRAY_LIMIT) {
+        _bits_.assign(65536 / 64, 0);
+        for (const uint16_t old_value : _values_) {
+            _bits_[old_value >> 6] |= uint64_t{1} << (old_value & 63);
+        }
+        _values_.clear();
+        _values_.shrink_to_fit();
+    }
+    return true;
+}
+
+bool DocumentBitmap::Container::Remove(uint16_t value) {
+    if (!_bits_.empty()) {
+        uint64_t& word = _bits_[value >> 6];
+        const uint64_t bit = uint64_t{1} << (value & 63);
+        const bool is_present = (word & bit) != 0;
+        word &= ~bit;
+        return is_present;
+    }
+    const auto it = lower_bound(_values_.begin(), _values_.end(), value);
+    if (it == _values_.end() || *it != value) {
+        return false;
+    }
+    _values_.erase(it);
+    return true;
+}
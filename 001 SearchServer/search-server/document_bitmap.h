@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Сжатое множество id документов в стиле Roaring. Id делятся на группы
+// по старшим 16 битам; группа хранится отсортированным массивом младших
+// 16 бит, пока в ней не больше ARRAY_LIMIT id, и битовой картой на 65536 бит
+// (8 КБ) после этого. Поэтому и редкие, и частые id занимают не больше
+// 2 байт на id, а проверка принадлежности не зависит от размера множества.
+class DocumentBitmap
+{
+public:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+
+    // document_id >= 0, порядок добавления любой, быстрее всего - по возрастанию
+    void Add(int document_id);
+
+    // Пустая группа-массив удаляется; битовая карта остаётся битовой картой, даже пустая
+    void Remove(int document_id);
+
+    bool Contains(int document_id) const {
+        if (_keys_.empty()) {
+            return false;
+        }
+        const uint32_t key = static_cast<uint32_t>(document_id) >> 16;
+        const auto it = std::lower_bound(_keys_.begin(), _keys_.end(), key);
+        if (it == _keys_.end() || *it != key) {
+            return false;
+        }
+        return _containers_[it - _keys_.begin()].Contains(static_cast<uint16_t>(document_id));
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    struct Container {
+        std::vector<uint16_t> _values_;     // отсортированы, пока _bits_ пуст
+        std::vector<uint64_t> _bits_;
+
+        bool Contains(uint16_t value) const {
+            if (!_bits_.empty()) {
+                return _bits_[value >> 6] >> (value & 63) & 1;
+            }
+            return std::binary_search(_values_.begin(), _values_.end(), value);
+        }
+
+        // false, если значение уже было
+        bool Add(uint16_t value);
+
+        // false, если значения не было
+        bool Remove(uint16_t value);
+    };
+
+    std::vector<uint32_t> _keys_;           // старшие 16 бит id, по возрастанию
+    std::vector<Container> _containers_;    // группа _keys_[i]
+    size_t size_ = 0;
+};
@@ -0,0 +1,222 @@
+#include <algorithm>
+
+#include "document_ordinals.h"
+
+using namespace std;
+
+DocumentOrdinals::Ordinal DocumentOrdinals::Add(int document_id) {
+    Reserve(size_ + 1);
+    const Ordinal ordinal = TakeOrdinal();
+    InsertSlot(document_id, ordinal);
+    ++size_;
+    if (_id_blocks_.empty()) {
+        _id_blocks_.push_back({document_id});
+        return ordinal;
+    }
+    const size_t block_index = FindBlock(document_id);
+    std::vector<int>& block = _id_blocks_[block_index];
+    block.insert(lower_bound(block.begin(), block.end(), document_id), document_id);
+    if (block.size() > 2 * ID_BLOCK_SIZE) {
+        std::vector<int> upper(block.begin() + ID_BLOCK_SIZE, block.end());
+        block.resize(ID_BLOCK_SIZE);
+        _id_blocks_.insert(_id_blocks_.begin() + block_index + 1, std::move(upper));
+    }
+    return ordinal;
+}
+
+std::vector<DocumentOrdinals::Ordinal> DocumentOrdinals::Add(const std::vector<int>& sorted_ids) {
+    Reserve(size_ + sorted_ids.size());
+    std::vector<Ordinal> ordinals(sorted_ids.size());
+    for (size_t i = 0; i < sorted_ids.size(); ++i) {
+        ordinals[i] = TakeOrdinal();
+        InsertSlot(sorted_ids[i], ordinals[i]);
+    }
+    if (sorted_ids.empty()) {
+        return ordinals;
+    }
+    if (_id_blocks_.empty() || GetLastId() < sorted_ids.front()) {
+        // Дописываются в конец: последний блок дополняется до ID_BLOCK_SIZE, затем новые блоки
+        for (const int document_id : sorted_ids) {
+            if (_id_blocks_.empty() || _id_blocks_.back().size() >= ID_BLOCK_SIZE) {
+                _id_blocks_.emplace_back().reserve(ID_BLOCK_SIZE);
+            }
+            _id_blocks_.back().push_back(document_id);
+        }
+        size_ += sorted_ids.size();
+        return ordinals;
+    }
+    std::vector<int> _ids;
+    _ids.reserve(size_ + sorted_ids.size());
+    for (const std::vector<int>& block : _id_blocks_) {
+        _ids.insert(_ids.end(), block.begin(), block.end());
+    }
+    const size_t old_size = _ids.size();
+    _ids.insert(_ids.end(), sorted_ids.begin(), sorted_ids.end());
+    inplace_merge(_ids.begin(), _ids.begin() + old_size, _ids.end());
+    SetIds(std::move(_ids));
+    return ordinals;
+}
+
+std::vector<DocumentOrdinals::Ordinal> DocumentOrdinals::GetNextOrdinals(size_t count) const {
+    // Тот же порядок, что у TakeOrdinal: освобождённые номера с конца, затем новые
+    std::vector<Ordinal> ordinals(count);
+    const size_t free_count = min(count, _free_ordinals_.size());
+    copy(_free_ordinals_.rbegin(), _free_ordinals_.rbegin() + free_count, ordinals.begin());
+    for (size_t i = free_count; i < count; ++i) {
+        ordinals[i] = capacity_ + static_cast<Ordinal>(i - free_count);
+    }
+    return ordinals;
+}
+
+void DocumentOrdinals::Remove(int document_id) {
+    EraseSlot(document_id);
+    --size_;
+    size_t block_index = FindBlock(document_id);
+    std::vector<int>& block = _id_blocks_[block_index];
+    block.erase(lower_bound(block.begin(), block.end(), document_id));
+    // Блок сливается с соседом, если вместе они не длиннее ID_BLOCK_SIZE,
+    // поэтому после удалений блоков остаётся O(size() / ID_BLOCK_SIZE)
+    if (block_index > 0 && _id_blocks_[block_index - 1].size() + block.size() <= ID_BLOCK_SIZE) {
+        std::vector<int>& previous = _id_blocks_[block_index - 1];
+        previous.insert(previous.end(), block.begin(), block.end());
+        _id_blocks_.erase(_id_blocks_.begin() + block_index);
+        --block_index;
+    }
+    if (block_index + 1 < _id_blocks_.size()
+        && _id_blocks_[block_index].size() + _id_blocks_[block_index + 1].size() <= ID_BLOCK_SIZE) {
+        std::vector<int>& next = _id_blocks_[block_index + 1];
+        _id_blocks_[block_index].insert(_id_blocks_[block_index].end(), next.begin(), next.end());
+        _id_blocks_.erase(_id_blocks_.begin() + block_index + 1);
+    }
+    if (_id_blocks_[block_index].empty()) {
+        _id_blocks_.erase(_id_blocks_.begin() + block_index);
+    }
+}
+
+void DocumentOrdinals::Remove(const std::vector<int>& sorted_ids) {
+    for (const int document_id : sorted_ids) {
+        EraseSlot(document_id);
+    }
+    // Оставшиеся id собираются за один проход
+    std::vector<int> _ids;
+    _ids.reserve(size_ - sorted_ids.size());
+    auto it_removed = sorted_ids.begin();
+    for (const std::vector<int>& block : _id_blocks_) {
+        for (const int document_id : block) {
+            if (it_removed != sorted_ids.end() && *it_removed == document_id) {
+                ++it_removed;
+            } else {
+                _ids.push_back(document_id);
+            }
+        }
+    }
+    SetIds(std::move(_ids));
+}
+
+void DocumentOrdinals::Restore(const std::vector<int>& sorted_ids, const std::vector<Ordinal>& ordinals) {
+    Reserve(sorted_ids.size());
+    for (size_t i = 0; i < sorted_ids.size(); ++i) {
+        InsertSlot(sorted_ids[i], ordinals[i]);
+        capacity_ = max(capacity_, ordinals[i] + 1);
+    }
+    SetIds(sorted_ids);
+    std::vector<uint8_t> is_used(capacity_, 0);
+    for (const Ordinal ordinal : ordinals) {
+        is_used[ordinal] = 1;
+    }
+    // TakeOrdinal берёт номера с конца, поэтому первыми выдаются меньшие
+    for (Ordinal ordinal = capacity_; ordinal-- > 0;) {
+        if (!is_used[ordinal]) {
+            _free_ordinals_.push_back(ordinal);
+        }
+    }
+}
+
+DocumentOrdinals::IdIterator DocumentOrdinals::LowerBound(int document_id) const {
+    if (_id_blocks_.empty()) {
+        return end();
+    }
+    const size_t block_index = FindBlock(document_id);
+    const std::vector<int>& block = _id_blocks_[block_index];
+    const size_t index = lower_bound(block.begin(), block.end(), document_id) - block.begin();
+    // За концом блока id нет только в последнем блоке
+    return index == block.size() ? end() : IdIterator(_id_blocks_, block_index, index);
+}
+
+//private
+
+DocumentOrdinals::Ordinal DocumentOrdinals::TakeOrdinal() {
+    if (_free_ordinals_.empty()) {
+        return capacity_++;
+    }
+    const Ordinal ordinal = _free_ordinals_.back();
+    _free_ordinals_.pop_back();
+    return ordinal;
+}
+
+void DocumentOrdinals::InsertSlot(int document_id, Ordinal ordinal) {
+    const size_t mask = _slots_.size() - 1;
+    size_t i = GetHomeSlot(document_id);
+    while (_slots_[i].document_id != EMPTY) {
+        i = (i + 1) & mask;
+    }
+    _slots_[i] = {document_id, ordinal};
+}
+
+void DocumentOrdinals::EraseSlot(int document_id) {
+    const size_t mask = _slots_.size() - 1;
+    size_t i = GetHomeSlot(document_id);
+    while (_slots_[i].document_id != document_id) {
+        i = (i + 1) & mask;
+    }
+    _free_ordinals_.push_back(_slots_[i].ordinal);
+    // Следующие записи цепочки, которые могут стоять в освободившемся слоте, сдвигаются в него
+    for (size_t j = (i + 1) & mask; _slots_[j].document_id != EMPTY; j = (j + 1) & mask) {
+        const size_t home = GetHomeSlot(_slots_[j].document_id);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            _slots_[i] = _slots_[j];
+            i = j;
+        }
+    }
+    _slots_[i].document_id = EMPTY;
+}
+
+void DocumentOrdinals::Reserve(size_t document_count) {
+    if (2 * document_count <= _slots_.size()) {
+        return;
+    }
+    int slot_bits = max(slot_bits_, 4);
+    while ((size_t{1} << slot_bits) < 2 * document_count) {
+        ++slot_bits;
+    }
+    std::vector<Slot> slots(size_t{1} << slot_bits, Slot{EMPTY, 0});
+    slots.swap(_slots_);
+    slot_bits_ = slot_bits;
+    for (const Slot& slot : slots) {
+        if (slot.document_id != EMPTY) {
+            InsertSlot(slot.document_id, slot.ordinal);
+        }
+    }
+}
+
+size_t DocumentOrdinals::FindBlock(int document_id) const {
+    // Первый блок, последний id которого не меньше document_id, иначе последний блок
+    return partition_point(_id_blocks_.begin(), _id_blocks_.end() - 1,
+                           [document_id](const std::vector<int>& block) { return block.back() < document_id; })
+        - _id_blocks_.begin();
+}
+
+void DocumentOrdinals::SetIds(std::vector<int> sorted_ids) {
+    size_ = sorted_ids.size();
+    _id_blocks_.clear();
+    if (size_ <= 2 * ID_BLOCK_SIZE) {
+        if (size_ > 0) {
+            _id_blocks_.push_back(std::move(sorted_ids));
+        }
+        return;
+    }
+    for (size_t begin = 0; begin < size_; begin += ID_BLOCK_SIZE) {
+        _id_blocks_.emplace_back(sorted_ids.begin() + begin,
+                                 sorted_ids.begin() + min(size_, begin + ID_BLOCK_SIZE));
+    }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+// Внутренние порядковые номера документов: плотные номера [0, GetCapacity()),
+// по которым SearchServer хранит столбцы данных документов. Номер удалённого
+// документа выдаётся следующему добавленному, поэтому столбцы не длиннее
+// наибольшего числа документов, когда-либо бывших в индексе одновременно.
+// id -> номер - таблица с открытой адресацией (линейное пробирование,
+// заполнена не более чем наполовину), удаление - обратным сдвигом без меток.
+// Id хранятся и по возрастанию - для перебора документов в порядке id - блоками
+// не длиннее 2 * ID_BLOCK_SIZE: добавление и удаление одного id сдвигают только
+// его блок, а не все id.
+class DocumentOrdinals
+{
+public:
+    using Ordinal = uint32_t;
+    static constexpr Ordinal NO_ORDINAL = std::numeric_limits<Ordinal>::max();
+    static constexpr size_t ID_BLOCK_SIZE = 512;
+
+    // Перебор id по возрастанию
+    class IdIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        IdIterator(const std::vector<std::vector<int>>& blocks, size_t block, size_t index)
+            : blocks_(&blocks)
+            , block_(block)
+            , index_(index)
+        {}
+
+        reference operator*() const {
+            return (*blocks_)[block_][index_];
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        IdIterator& operator++() {
+            if (++index_ == (*blocks_)[block_].size()) {
+                ++block_;
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        IdIterator operator++(int) {
+            IdIterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const IdIterator& other) const {
+            return block_ == other.block_ && index_ == other.index_;
+        }
+
+        bool operator!=(const IdIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const std::vector<std::vector<int>>* blocks_;
+        size_t block_;
+        size_t index_;
+    };
+
+    // Номер документа или NO_ORDINAL
+    Ordinal Find(int document_id) const {
+        if (_slots_.empty()) {
+            return NO_ORDINAL;
+        }
+        const size_t mask = _slots_.size() - 1;
+        for (size_t i = GetHomeSlot(document_id); _slots_[i].document_id != EMPTY; i = (i + 1) & mask) {
+            if (_slots_[i].document_id == document_id) {
+                return _slots_[i].ordinal;
+            }
+        }
+        return NO_ORDINAL;
+    }
+
+    bool Contains(int document_id) const {
+        return Find(document_id) != NO_ORDINAL;
+    }
+
+    // document_id >= 0 ещё нет в таблице
+    Ordinal Add(int document_id);
+
+    // Id по возрастанию, ещё не добавленные; номера - в порядке sorted_ids.
+    // Отсортированные id дополняются одним слиянием
+    std::vector<Ordinal> Add(const std::vector<int>& sorted_ids);
+
+    // Номера, которые получат следующие count добавленных документов, без изменения таблицы
+    std::vector<Ordinal> GetNextOrdinals(size_t count) const;
+
+    // document_id есть в таблице; его номер освобождается
+    void Remove(int document_id);
+
+    // Id по возрастанию без повторов, все есть в таблице
+    void Remove(const std::vector<int>& sorted_ids);
+
+    // Заполняет пустую таблицу id по возрастанию с заданными различными номерами
+    // (номера из сохранённого индекса); номера меньше наибольшего, не занятые id, свободны
+    void Restore(const std::vector<int>& sorted_ids, const std::vector<Ordinal>& ordinals);
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Номера документов меньше GetCapacity()
+    Ordinal GetCapacity() const {
+        return capacity_;
+    }
+
+    // Id документов по возрастанию
+    IdIterator begin() const {
+        return {_id_blocks_, 0, 0};
+    }
+
+    IdIterator end() const {
+        return {_id_blocks_, _id_blocks_.size(), 0};
+    }
+
+    // Первый id не меньше document_id
+    IdIterator LowerBound(int document_id) const;
+
+    // Наименьший и наибольший id, таблица не пуста
+    int GetFirstId() const {
+        return _id_blocks_.front().front();
+    }
+
+    int GetLastId() const {
+        return _id_blocks_.back().back();
+    }
+
+private:
+    static constexpr int EMPTY = -1;
+
+    struct Slot {
+        int document_id;    // EMPTY - пустой слот
+        Ordinal ordinal;
+    };
+
+    std::vector<Slot> _slots_;              // размер - степень двойки
+    int slot_bits_ = 0;
+    std::vector<std::vector<int>> _id_blocks_;     // непустые, по возрастанию id
+    size_t size_ = 0;
+    std::vector<Ordinal> _free_ordinals_;
+    Ordinal capacity_ = 0;
+
+    // Фибоначчиево хеширование: старшие биты произведения, соседние id попадают в разные слоты
+    size_t GetHomeSlot(int document_id) const {
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(document_id))
+                                    * 0x9E3779B97F4A7C15ull) >> (64 - slot_bits_));
+    }
+
+    Ordinal TakeOrdinal();
+
+    void InsertSlot(int document_id, Ordinal ordinal);
+
+    // Освобождает номер документа
+    void EraseSlot(int document_id);
+
+    // Таблица на не менее чем 2 * document_count слотов
+    void Reserve(size_t document_count);
+
+    // Блок, в котором id document_id стоит или должен стоять; блоки не пусты
+    size_t FindBlock(int document_id) const;
+
+    // Делит отсортированные id на блоки по ID_BLOCK_SIZE
+    void SetIds(std::vector<int> sorted_ids);
+};
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "forward_index.h"
+
+using namespace std;
+
+void ForwardIndex::Set(Ordinal ordinal, const std::vector<std::pair<TermId, uint32_t>>& term_counts) {
+    Release(ordinal);
+    if (ordinal >= _ordinal_to_extent_.size()) {
+        _ordinal_to_extent_.resize(ordinal + 1);
+    }
+    _ordinal_to_extent_[ordinal] = {_terms_.size(), static_cast<uint32_t>(term_counts.size())};
+    for (const auto& [term_id, count] : term_counts) {
+        _terms_.push_back(term_id);
+        _counts_.push_back(count);
+    }
+}
+
+std::vector<size_t> ForwardIndex::Allocate(const std::vector<Ordinal>& ordinals, const std::vector<uint32_t>& sizes) {
+    // Сжатие массивов переносит отрезки, поэтому все освобождения - до раздачи новых
+    Ordinal max_ordinal = 0;
+    for (const Ordinal ordinal : ordinals) {
+        Release(ordinal);
+        max_ordinal = max(max_ordinal, ordinal);
+    }
+    if (!ordinals.empty() && max_ordinal >= _ordinal_to_extent_.size()) {
+        _ordinal_to_extent_.resize(max_ordinal + 1);
+    }
+    std::vector<size_t> offsets(ordinals.size());
+    size_t offset = _terms_.size();
+    for (size_t i = 0; i < ordinals.size(); ++i) {
+        offsets[i] = offset;
+        _ordinal_to_extent_[ordinals[i]] = {offset, sizes[i]};
+        offset += sizes[i];
+    }
+    _terms_.resize(offset);
+    _counts_.resize(offset);
+    return offsets;
+}
+
+void ForwardIndex::Write(size_t offset, const std::vector<std::pair<TermId, uint32_t>>& term_counts) {
+    for (const auto& [term_id, count] : term_counts) {
+        _terms_[offset] = term_id;
+        _counts_[offset] = count;
+        ++offset;
+    }
+}
+
+void ForwardIndex::Release(Ordinal ordinal) {
+    if (ordinal >= _ordinal_to_extent_.size()) {
+        return;
+    }
+    released_size_ += _ordinal_to_extent_[ordinal].size;
+    _ordinal_to_extent_[ordinal] = {};
+    if (released_size_ * 2 > _terms_.size()) {
+        Compact();
+    }
+}
+
+//private
+
+void ForwardIndex::Compact() {
+    std::vector<TermId> terms;
+    std::vector<uint32_t> counts;
+    terms.reserve(_terms_.size() - released_size_);
+    counts.reserve(_terms_.size() - released_size_);
+    for (Extent& extent : _ordinal_to_extent_) {
+        const size_t offset = terms.size();
+        terms.insert(terms.end(), _terms_.begin() + extent.offset, _terms_.begin() + extent.offset + extent.size);
+        counts.insert(counts.end(), _counts_.begin() + extent.offset, _counts_.begin() + extent.offset + extent.size);
+        extent.offset = offset;
+    }
+    _terms_.swap(terms);
+    _counts_.swap(counts);
+    released_size_ = 0;
+}
+
+size_t TermFrequencies::count(std::string_view word) const {
+    return FindIndex(word) != size();
+}
+
+double TermFrequencies::at(std::string_view word) const {
+    const size_t index = FindIndex(word);
+    if (index == size()) {
+        throw out_of_range("Word doesn't exist"s);
+    }
+    return counts_[index] * inv_word_count_;
+}
+
+size_t TermFrequencies::FindIndex(std::string_view word) const {
+    const TermId term_id = dictionary_->Find(word);
+    const auto it = lower_bound(terms_.begin(), terms_.end(), term_id);
+    return it != terms_.end() && *it == term_id ? it - terms_.begin() : size();
+}
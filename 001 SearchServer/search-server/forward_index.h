@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document_ordinals.h"
+#include "paginator.h"
+#include "term_dictionary.h"
+
+// Прямой индекс: слова каждого документа по его внутреннему номеру - id слов
+// по возрастанию и числа их вхождений (частота слова - число вхождений, делённое
+// на число слов документа, поэтому хранится точно). Слова всех документов лежат
+// подряд в двух общих массивах, документ - отрезок в них. Отрезки удалённых
+// документов остаются в массивах, пока не займут их половину, затем массивы сжимаются.
+class ForwardIndex
+{
+public:
+    using TermId = TermDictionary::TermId;
+    using Ordinal = DocumentOrdinals::Ordinal;
+    using TermIterator = std::vector<TermId>::const_iterator;
+    using CountIterator = std::vector<uint32_t>::const_iterator;
+
+    // Слова документа - пары (id слова, число вхождений) по возрастанию id;
+    // прежние слова документа освобождаются
+    void Set(Ordinal ordinal, const std::vector<std::pair<TermId, uint32_t>>& term_counts);
+
+    // Для пачки документов: освобождает прежние слова документов ordinals, занимает в конце
+    // массивов отрезки из sizes[i] слов и возвращает их начала. Отрезки заполняются Write,
+    // они не пересекаются, поэтому разные отрезки можно заполнять параллельно
+    std::vector<size_t> Allocate(const std::vector<Ordinal>& ordinals, const std::vector<uint32_t>& sizes);
+
+    // Записывает слова документа в отрезок, занятый для него Allocate
+    void Write(size_t offset, const std::vector<std::pair<TermId, uint32_t>>& term_counts);
+
+    void Release(Ordinal ordinal);
+
+    // Id слов документа по возрастанию
+    IteratorRange<TermIterator> GetTerms(Ordinal ordinal) const {
+        const Extent& extent = GetExtent(ordinal);
+        return {_terms_.begin() + extent.offset, _terms_.begin() + extent.offset + extent.size};
+    }
+
+    // Числа вхождений слов документа в порядке GetTerms
+    CountIterator GetCounts(Ordinal ordinal) const {
+        return _counts_.begin() + GetExtent(ordinal).offset;
+    }
+
+private:
+    struct Extent {
+        size_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    std::vector<TermId> _terms_;
+    std::vector<uint32_t> _counts_;
+    std::vector<Extent> _ordinal_to_extent_;
+    size_t released_size_ = 0;      // слов в освобождённых отрезках
+
+    const Extent& GetExtent(Ordinal ordinal) const {
+        static const Extent empty_extent;
+        return ordinal < _ordinal_to_extent_.size() ? _ordinal_to_extent_[ordinal] : empty_extent;
+    }
+
+    // Переписывает отрезки документов подряд, без освобождённых
+    void Compact();
+};
+
+// Частоты слов документа в порядке id словаря (не по алфавиту) - представление его отрезка
+// прямого индекса без копирования. Действительно, пока индекс не изменяется
+class TermFrequencies
+{
+public:
+    using TermId = ForwardIndex::TermId;
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        Iterator(const TermFrequencies& frequencies, size_t index)
+            : frequencies_(&frequencies)
+            , index_(index)
+        {}
+
+        reference operator*() const {
+            value_ = frequencies_->GetEntry(index_);
+            return value_;
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const TermFrequencies* frequencies_;
+        size_t index_;
+        mutable value_type value_;
+    };
+
+    TermFrequencies(const TermDictionary& dictionary, IteratorRange<ForwardIndex::TermIterator> terms,
+                    ForwardIndex::CountIterator counts, double inv_word_count)
+        : dictionary_(&dictionary)
+        , terms_(terms)
+        , counts_(counts)
+        , inv_word_count_(inv_word_count)
+    {}
+
+    Iterator begin() const {
+        return {*this, 0};
+    }
+
+    Iterator end() const {
+        return {*this, size()};
+    }
+
+    size_t size() const {
+        return terms_.size();
+    }
+
+    bool empty() const {
+        return terms_.size() == 0;
+    }
+
+    // 1, если слово есть в документе, иначе 0
+    size_t count(std::string_view word) const;
+
+    // Частота слова; out_of_range, если слова нет в документе
+    double at(std::string_view word) const;
+
+private:
+    const TermDictionary* dictionary_;
+    IteratorRange<ForwardIndex::TermIterator> terms_;
+    ForwardIndex::CountIterator counts_;
+    double inv_word_count_;
+
+    std::pair<std::string_view, double> GetEntry(size_t index) const {
+        return {dictionary_->GetTerm(terms_.begin()[index]), counts_[index] * inv_word_count_};
+    }
+
+    // Индекс слова в отрезке или size()
+    size_t FindIndex(std::string_view word) const;
+};
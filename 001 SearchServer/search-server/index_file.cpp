@@ -0,0 +1,169 @@
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "index_file.h"
+#include "posting_list.h"
+
+using namespace std;
+
+uint32_t UpdateCrc32(uint32_t crc, const void* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> result{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// ----------MappedFile----------
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Can't open index file "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("Can't read index file "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* address = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Can't map index file "s + path);
+        }
+        data_ = static_cast<const uint8_t*>(address);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+const IndexFileHeader& MappedFile::GetIndexHeader(bool verify_checksum) const {
+    const IndexFileHeader& header = *GetArray<IndexFileHeader>(0, 1);
+    if (memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC)) != 0) {
+        throw std::runtime_error("Not an index file");
+    }
+    if (header.version != INDEX_FILE_VERSION) {
+        throw std::runtime_error("Unsupported index file version "s + std::to_string(header.version));
+    }
+    if (header.byte_order != INDEX_FILE_BYTE_ORDER || header.block_record_size != sizeof(PostingList::Block)) {
+        throw std::runtime_error("Index file was written on an incompatible platform");
+    }
+    if (header.header_checksum != UpdateCrc32(0, &header, offsetof(IndexFileHeader, header_checksum))
+        || header.file_size != size_) {
+        throw std::runtime_error("Index file is corrupted");
+    }
+    if (verify_checksum
+        && header.payload_checksum != UpdateCrc32(0, data_ + sizeof(IndexFileHeader),
+                                                  size_ - sizeof(IndexFileHeader))) {
+        throw std::runtime_error("Index file is corrupted");
+    }
+    return header;
+}
+
+std::vector<std::string_view> MappedFile::GetIndexStrings(uint64_t offset) const {
+    const uint64_t count = *GetArray<uint64_t>(offset, 1);
+    const uint64_t* offsets = GetArray<uint64_t>(offset + sizeof(uint64_t), count + 1);
+    const uint64_t chars_offset = offset + sizeof(uint64_t) * (count + 2);
+    const char* chars = GetArray<char>(chars_offset, offsets[count]);
+    std::vector<std::string_view> result;
+    result.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > offsets[count]) {
+            throw std::runtime_error("Index file is corrupted");
+        }
+        result.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return result;
+}
+
+// ----------IndexFileWriter----------
+
+IndexFileWriter::IndexFileWriter(const std::string& path)
+    : path_(path)
+    , temp_path_(path + ".tmp"s)
+    , out_(temp_path_, std::ios::binary | std::ios::trunc)
+{
+    if (!out_) {
+        throw std::runtime_error("Can't create index file "s + temp_path_);
+    }
+    // Место под заголовок, он записывается последним
+    const IndexFileHeader empty_header{};
+    out_.write(reinterpret_cast<const char*>(&empty_header), sizeof(empty_header));
+    offset_ = sizeof(empty_header);
+}
+
+void IndexFileWriter::Write(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), size);
+    payload_checksum_ = UpdateCrc32(payload_checksum_, data, size);
+    offset_ += size;
+}
+
+void IndexFileWriter::Align() {
+    static const char zeros[8] = {};
+    if (offset_ % 8 != 0) {
+        Write(zeros, 8 - offset_ % 8);
+    }
+}
+
+void IndexFileWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    Align();
+    WriteValue<uint64_t>(strings.size());
+    uint64_t chars_size = 0;
+    WriteValue(chars_size);
+    for (const std::string_view str : strings) {
+        chars_size += str.size();
+        WriteValue(chars_size);
+    }
+    for (const std::string_view str : strings) {
+        Write(str.data(), str.size());
+    }
+}
+
+void IndexFileWriter::Finish(IndexFileHeader header) {
+    Align();
+    memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC));
+    header.version = INDEX_FILE_VERSION;
+    header.byte_order = INDEX_FILE_BYTE_ORDER;
+    header.block_record_size = sizeof(PostingList::Block);
+    header.reserved = 0;
+    header.file_size = offset_;
+    header.payload_checksum = payload_checksum_;
+    header.header_checksum = UpdateCrc32(0, &header, offsetof(IndexFileHeader, header_checksum));
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    if (!out_) {
+        std::remove(temp_path_.c_str());
+        throw std::runtime_error("Can't write index file "s + temp_path_);
+    }
+    if (std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        std::remove(temp_path_.c_str());
+        throw std::runtime_error("Can't replace index file "s + path_);
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Файл индекса SearchServer (SaveIndex/OpenIndex), версия INDEX_FILE_VERSION.
+//
+// Заголовок IndexFileHeader, за ним секции, каждая с границы 8 байт:
+// - стоп-слова и слова словаря - секции строк: uint64_t count,
+//   uint64_t offsets[count + 1] от начала символов, затем символы;
+// - posting lists: uint64_t count, IndexPostingRecord[count],
+//   затем таблицы блоков PostingList::Block, байты записей и байты позиций;
+// - документы: uint64_t count, IndexDocumentRecord[count] по возрастанию id,
+//   uint64_t term_count, uint32_t term_ids[term_count], uint32_t term_counts[term_count].
+//   Записи posting lists ссылаются на внутренние номера документов, поэтому номера
+//   сохраняются в IndexDocumentRecord и восстанавливаются при открытии.
+// Числа хранятся в порядке байт записавшей машины, файл с другим порядком
+// байт или размером записей отвергается по заголовку.
+
+const char INDEX_FILE_MAGIC[8] = {'S', 'S', 'I', 'N', 'D', 'E', 'X', '\0'};
+const uint32_t INDEX_FILE_VERSION = 4;
+const uint32_t INDEX_FILE_BYTE_ORDER = 0x01020304;
+
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t block_record_size;     // sizeof(PostingList::Block)
+    uint32_t reserved;
+    uint64_t file_size;
+    uint64_t stop_words_offset;
+    uint64_t terms_offset;
+    uint64_t postings_offset;
+    uint64_t documents_offset;
+    uint32_t payload_checksum;      // CRC-32 всего, что после заголовка
+    uint32_t header_checksum;       // CRC-32 заголовка до этого поля
+};
+
+struct IndexPostingRecord {
+    uint64_t blocks_offset;         // смещения - от начала файла
+    uint64_t block_count;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t positions_offset;
+    uint64_t positions_size;
+    uint64_t size;
+    double max_term_freq;
+};
+
+struct IndexDocumentRecord {
+    int32_t id;
+    uint32_t ordinal;               // DocumentOrdinals
+    int32_t rating;
+    int32_t status;
+    uint32_t term_count;
+    uint32_t reserved;
+    uint64_t first_term;            // индекс в term_ids/term_counts
+    double inv_word_count;
+};
+
+// CRC-32 (как в zlib), crc - результат для предыдущих данных или 0
+uint32_t UpdateCrc32(uint32_t crc, const void* data, size_t size);
+
+// Файл, отображённый в память только для чтения. Отображение общее (MAP_SHARED):
+// страницы файла разделяются всеми процессами, открывшими тот же файл.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+    // Массив count элементов T по смещению offset с проверкой границ и выравнивания
+    template <typename T>
+    const T* GetArray(uint64_t offset, uint64_t count) const {
+        if (offset > size_ || count > (size_ - offset) / sizeof(T) || offset % alignof(T) != 0) {
+            throw std::runtime_error("Index file is corrupted");
+        }
+        return reinterpret_cast<const T*>(data_ + offset);
+    }
+
+    // Проверенный заголовок файла индекса; контрольная сумма данных
+    // проверяется только при verify_checksum (для этого читается весь файл)
+    const IndexFileHeader& GetIndexHeader(bool verify_checksum) const;
+
+    // Секция строк по смещению offset, строки ссылаются на отображённую память
+    std::vector<std::string_view> GetIndexStrings(uint64_t offset) const;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Запись файла индекса: данные пишутся во временный файл, который
+// заменяет path только после успешной записи заголовка (Finish)
+class IndexFileWriter
+{
+public:
+    explicit IndexFileWriter(const std::string& path);
+
+    uint64_t GetOffset() const {
+        return offset_;
+    }
+
+    void Write(const void* data, size_t size);
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        Write(&value, sizeof(T));
+    }
+
+    // Дополняет нулями до границы 8 байт
+    void Align();
+
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+    // Заполняет служебные поля header, записывает его и переименовывает файл
+    void Finish(IndexFileHeader header);
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream out_;
+    uint64_t offset_ = 0;
+    uint32_t payload_checksum_ = 0;
+};
@@ -21,6 +21,7 @@
 #include "string_processing.h"
 #include "log_duration.h"
 #include "process_queries.h"
+#include "remove_duplicates.h"
 
 using namespace std;
 //using namespace std::string_literals;
@@ -48,7 +49,13 @@ Match documents: 2164
 */
 
 
-int main() {
+// С аргументом test выполняются только проверки, без замеров
+int main(int argc, char* argv[]) {
+
+    TestSearchServer();
+    if (argc > 1 && argv[1] == "test"sv) {
+        return 0;
+    }
 
 //-----FindTopDocument and ProcessQueries and MatchDocument
 
@@ -97,11 +104,29 @@ int main() {
         TEST_FT(seq);
         TEST_FT(par);
 
+        TEST_RM(TfIdfRanking, seq);
+        TEST_RM(Bm25Ranking, seq);
+        TEST_RM(TfIdfRanking, par);
+        TEST_RM(Bm25Ranking, par);
+
+        const auto rating_predicate = [](int, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL && rating >= 2;
+        };
+        const DocumentAttributeFilter rating_filter{DocumentStatus::ACTUAL, 2};
+        TEST_AF(seq, rating_predicate);
+        TEST_AF(seq, rating_filter);
+        TEST_AF(par, rating_predicate);
+        TEST_AF(par, rating_filter);
+
         TEST_QP(ProcessQueries);
         TEST_QP(ProcessQueriesJoined);
 
         TEST_Mt(seq);
         TEST_Mt(par);
+        TEST_MDS(seq);
+        TEST_MDS(par);
+        TEST_QC(0);
+        TEST_QC(50);
 
     }
 
@@ -162,10 +187,117 @@ int main() {
                 }
                 TEST_RD(par);
             }
+            {
+                SearchServer search_server(dictionary[0]);
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+                }
+                TEST_RDS(seq);
+                TEST_RDS(par);
+            }
         }
     }
 //----RemoveDocument.End
 
 
+//----AddDocuments
+    {
+        mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 20'000, 100);
+
+        TEST_AD1;
+        TEST_AD(seq, 20'000);
+        TEST_AD(par, 20'000);
+        TEST_AD(seq, 1'000);
+        TEST_AD(par, 1'000);
+    }
+//----AddDocuments.End
+
+
+//----SaveIndex/OpenIndex
+    {
+        mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 20'000, 100);
+        TEST_OI;
+    }
+//----SaveIndex/OpenIndex.End
+
+
+//----RemoveDuplicates
+    {
+        SearchServer search_server("and with"s);
+        int id = 0;
+        for (
+            const string& text : {
+                "funny pet and nasty rat"s,
+                "funny pet with curly hair"s,
+                "funny pet and nasty rat"s,
+                "pet with rat and rat and rat"s,
+                "nasty rat with curly hair"s,
+                "funny pet with curly hair and nasty rat"s,
+                "funny funny pet with curly curly hair"s,
+            }
+        ) {
+            search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+        }
+        // дубликаты 3 и 7
+        RemoveDuplicates(search_server);
+        // почти-дубликаты 4 (сходство с 1 - 1/2) и 6 (сходство с 2 - 2/3)
+        RemoveDuplicates(execution::par, search_server, DuplicateDetector(0.5));
+        cout << search_server.GetDocumentCount() << " documents left"s << endl;
+
+        mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+        auto documents = GenerateQueries(generator, dictionary, 20'000, 100);
+        // вторая половина - копии первой, к каждой четвёртой копии добавлено одно слово
+        for (size_t i = 0; i < documents.size() / 2; ++i) {
+            documents[documents.size() / 2 + i] = documents[i];
+            if (i % 4 == 0) {
+                documents[documents.size() / 2 + i] += " "s + dictionary[i % dictionary.size()];
+            }
+        }
+        SearchServer big_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            big_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        {
+            const SearchServer& search_server = big_server;
+            TEST_DD(DuplicateDetector(), seq);
+            TEST_DD(DuplicateDetector(), par);
+            TEST_DD(DuplicateDetector(0.9), seq);
+            TEST_DD(DuplicateDetector(0.9), par);
+        }
+    }
+//----RemoveDuplicates.End
+
+
+//----ConcurrentMap
+    {
+        TEST_CM(1);
+        TEST_CM(2);
+        TEST_CM(4);
+        TEST_CM(8);
+        TEST_CM(16);
+        TEST_CM(32);
+        TEST_CM(64);
+    }
+//----ConcurrentMap.End
+
+
+//----ConcurrentSearchServer
+    {
+        mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+        const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
+        TEST_CS(false);
+        TEST_CS(true);
+    }
+//----ConcurrentSearchServer.End
+
+
      return 0;
 }
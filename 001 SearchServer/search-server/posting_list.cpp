@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "posting_list.h"
+
+using namespace std;
+
+namespace {
+
+void PutVarint(uint32_t value, std::vector<uint8_t>& out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t GetVarint(const uint8_t*& pos) {
+    uint32_t result = 0;
+    int shift = 0;
+    while (*pos & 0x80) {
+        result |= static_cast<uint32_t>(*pos++ & 0x7F) << shift;
+        shift += 7;
+    }
+    result |= static_cast<uint32_t>(*pos++) << shift;
+    return result;
+}
+
+// Пропуск count значений varint: у последнего байта каждого старший бит сброшен
+void SkipVarints(uint32_t count, const uint8_t*& pos) {
+    while (count > 0) {
+        count -= (*pos++ & 0x80) == 0;
+    }
+}
+
+} // namespace
+
+// ----------Iterator----------
+
+PostingList::Iterator::Iterator(const PostingList* list, size_t block_index)
+    : blocks_(list->GetBlocks())
+    , block_count_(list->GetBlockCount())
+    , data_(list->GetData())
+    , positions_(list->GetPositionData())
+    , block_index_(block_index)
+{
+    if (block_index_ < block_count_) {
+        LoadBlock();
+    }
+}
+
+void PostingList::Iterator::LoadBlock() {
+    const Block& block = blocks_[block_index_];
+    pos_ = data_ + block.offset;
+    current_.document_id = block.first_id;
+    current_.count = GetVarint(pos_);
+    current_.ordinal = GetVarint(pos_);
+    left_in_block_ = block.size - 1;
+    positions_pos_ = positions_ + block.positions_offset;
+    skip_positions_ = 0;
+}
+
+PostingList::Iterator& PostingList::Iterator::operator++() {
+    if (left_in_block_ > 0) {
+        skip_positions_ += current_.count;
+        current_.document_id += static_cast<int>(GetVarint(pos_));
+        current_.count = GetVarint(pos_);
+        current_.ordinal = GetVarint(pos_);
+        --left_in_block_;
+    } else if (++block_index_ < block_count_) {
+        LoadBlock();
+    }
+    return *this;
+}
+
+PostingList::Iterator PostingList::Iterator::operator++(int) {
+    Iterator old = *this;
+    ++(*this);
+    return old;
+}
+
+void PostingList::Iterator::SkipTo(int document_id) {
+    if (block_index_ >= block_count_ || current_.document_id >= document_id) {
+        return;
+    }
+    if (blocks_[block_index_].last_id < document_id) {
+        // Галопирующий поиск блока: шаг удваивается, затем двоичный поиск в последнем интервале
+        size_t step = 1;
+        size_t low = block_index_ + 1;
+        while (low + step - 1 < block_count_ && blocks_[low + step - 1].last_id < document_id) {
+            low += step;
+            step *= 2;
+        }
+        const Block* it = lower_bound(blocks_ + low, blocks_ + std::min(low + step - 1, block_count_), document_id,
+                                      [](const Block& block, int id) { return block.last_id < id; });
+        block_index_ = it - blocks_;
+        if (block_index_ == block_count_) {
+            left_in_block_ = 0;
+            return;
+        }
+        LoadBlock();
+    }
+    // last_id текущего блока >= document_id, поэтому из блока не выходим
+    while (current_.document_id < document_id) {
+        ++(*this);
+    }
+}
+
+void PostingList::Iterator::NextBlock() {
+    if (++block_index_ < block_count_) {
+        LoadBlock();
+    } else {
+        block_index_ = block_count_;
+        left_in_block_ = 0;
+    }
+}
+
+PostingList::Iterator::BlockBound PostingList::Iterator::GetBlockBound(int document_id) const {
+    const Block* blocks_end = blocks_ + block_count_;
+    const Block* it = lower_bound(blocks_ + std::min(block_index_, block_count_), blocks_end, document_id,
+                                  [](const Block& block, int id) { return block.last_id < id; });
+    if (it == blocks_end) {
+        return {INT_MAX, 0.0, 0};
+    }
+    return {it->last_id, it->max_term_freq, it->tag_mask};
+}
+
+void PostingList::Iterator::GetPositions(std::vector<uint32_t>& positions) {
+    // Позиции пропущенных записей блока пропускаются только сейчас
+    SkipVarints(skip_positions_, positions_pos_);
+    skip_positions_ = 0;
+    positions.resize(current_.count);
+    const uint8_t* pos = positions_pos_;
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < current_.count; ++i) {
+        position += GetVarint(pos);
+        positions[i] = position;
+    }
+}
+
+// ----------PostingList----------
+
+void PostingList::Add(int document_id, uint32_t ordinal, uint32_t tag_mask, const std::vector<uint32_t>& positions,
+                      double term_freq) {
+    MakeOwned();
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    const Posting posting{document_id, static_cast<uint32_t>(positions.size()), ordinal};
+    if (_blocks_.empty() || _blocks_.back().last_id < document_id) {
+        // Обычный случай: id растут, дописываем в конец последнего блока
+        if (_blocks_.empty() || _blocks_.back().size == BLOCK_SIZE) {
+            _blocks_.push_back({document_id, document_id, static_cast<uint32_t>(_data_.size()), 1,
+                                static_cast<uint32_t>(_positions_.size()), tag_mask, term_freq});
+        } else {
+            Block& block = _blocks_.back();
+            PutVarint(static_cast<uint32_t>(document_id - block.last_id), _data_);
+            block.last_id = document_id;
+            ++block.size;
+            block.tag_mask |= tag_mask;
+            block.max_term_freq = std::max(block.max_term_freq, term_freq);
+        }
+        PutVarint(posting.count, _data_);
+        PutVarint(posting.ordinal, _data_);
+        EncodePositions(&posting, &posting + 1, positions.data(), _positions_);
+        ++size_;
+        return;
+    }
+
+    const auto it = lower_bound(_blocks_.begin(), _blocks_.end(), document_id,
+                                [](const Block& block, int id) { return block.last_id < id; });
+    const size_t block_index = it - _blocks_.begin();
+    std::vector<Posting> postings = DecodeBlock(block_index);
+    const auto pos = lower_bound(postings.begin(), postings.end(), document_id,
+                                 [](const Posting& posting, int id) { return posting.document_id < id; });
+    if (pos != postings.end() && pos->document_id == document_id) {
+        throw invalid_argument("Document is already in the posting list"s);
+    }
+    // Позиции каждой записи кодируются независимо, поэтому вставляются готовыми байтами
+    std::vector<uint8_t> position_bytes;
+    EncodePositions(&posting, &posting + 1, positions.data(), position_bytes);
+    const uint32_t positions_begin = GetPositionsOffset(block_index, postings.begin(), pos);
+    _positions_.insert(_positions_.begin() + positions_begin, position_bytes.begin(), position_bytes.end());
+    postings.insert(pos, posting);
+    ReplaceBlock(block_index, postings, std::max(it->max_term_freq, term_freq), it->tag_mask | tag_mask,
+                 static_cast<int64_t>(position_bytes.size()));
+    ++size_;
+}
+
+bool PostingList::Append(PostingList&& other) {
+    if (other.empty()) {
+        return true;
+    }
+    if (empty()) {
+        *this = std::move(other);
+        return true;
+    }
+    if (GetBlocks()[GetBlockCount() - 1].last_id >= other.GetBlocks()[0].first_id) {
+        return false;
+    }
+    MakeOwned();
+    other.MakeOwned();
+    // Неполный последний блок дополняется первыми записями other, как при добавлении по одной,
+    // остаток первого блока other становится отдельным блоком. Записи блока после первой
+    // хранят разность с предыдущим id, а позиции каждой записи закодированы независимо,
+    // поэтому перекодируется только запись, с которой начинается блок; остальное - байтами
+    size_t first_moved = 0;     // блоки other начиная с этого переносятся целиком
+    if (_blocks_.back().size < BLOCK_SIZE) {
+        const Block head = other._blocks_[0];
+        const uint32_t fill = std::min(BLOCK_SIZE - _blocks_.back().size, head.size);
+        const size_t data_end = other._blocks_.size() > 1 ? other._blocks_[1].offset : other._data_.size();
+        const size_t positions_end = other._blocks_.size() > 1 ? other._blocks_[1].positions_offset
+                                                                : other._positions_.size();
+        const uint8_t* const data = other._data_.data();
+        const uint8_t* const positions = other._positions_.data();
+        // Итератор на последней записи, переходящей в последний блок списка
+        Iterator it = other.begin();
+        for (uint32_t i = 1; i < fill; ++i) {
+            ++it;
+        }
+        const uint8_t* positions_split = it.positions_pos_;
+        SkipVarints(it.skip_positions_ + it->count, positions_split);
+
+        Block& last = _blocks_.back();
+        PutVarint(static_cast<uint32_t>(head.first_id - last.last_id), _data_);
+        _data_.insert(_data_.end(), data + head.offset, it.pos_);
+        last.last_id = it->document_id;
+        last.size += fill;
+        // Метки и граница TF известны только для блока целиком
+        last.tag_mask |= head.tag_mask;
+        last.max_term_freq = std::max(last.max_term_freq, head.max_term_freq);
+        _positions_.insert(_positions_.end(), positions + head.positions_offset, positions_split);
+        if (fill < head.size) {
+            ++it;
+            _blocks_.push_back({it->document_id, head.last_id, static_cast<uint32_t>(_data_.size()), head.size - fill,
+                                static_cast<uint32_t>(_positions_.size()), head.tag_mask, head.max_term_freq});
+            PutVarint(it->count, _data_);
+            PutVarint(it->ordinal, _data_);
+            _data_.insert(_data_.end(), it.pos_, data + data_end);
+            _positions_.insert(_positions_.end(), positions_split, positions + positions_end);
+        }
+        first_moved = 1;
+    }
+    if (first_moved < other._blocks_.size()) {
+        const Block& first = other._blocks_[first_moved];
+        const int64_t data_shift = static_cast<int64_t>(_data_.size()) - first.offset;
+        const int64_t positions_shift = static_cast<int64_t>(_positions_.size()) - first.positions_offset;
+        for (size_t i = first_moved; i < other._blocks_.size(); ++i) {
+            Block block = other._blocks_[i];
+            block.offset = static_cast<uint32_t>(block.offset + data_shift);
+            block.positions_offset = static_cast<uint32_t>(block.positions_offset + positions_shift);
+            _blocks_.push_back(block);
+        }
+        _data_.insert(_data_.end(), other._data_.begin() + first.offset, other._data_.end());
+        _positions_.insert(_positions_.end(), other._positions_.begin() + first.positions_offset,
+                           other._positions_.end());
+    }
+    size_ += other.size_;
+    max_term_freq_ = std::max(max_term_freq_, other.max_term_freq_);
+    return true;
+}
+
+bool PostingList::Erase(int document_id) {
+    MakeOwned();
+    const auto it = lower_bound(_blocks_.begin(), _blocks_.end(), document_id,
+                                [](const Block& block, int id) { return block.last_id < id; });
+    if (it == _blocks_.end() || it->first_id > document_id) {
+        return false;
+    }
+    const size_t block_index = it - _blocks_.begin();
+    std::vector<Posting> postings = DecodeBlock(block_index);
+    const auto pos = lower_bound(postings.begin(), postings.end(), document_id,
+                                 [](const Posting& posting, int id) { return posting.document_id < id; });
+    if (pos == postings.end() || pos->document_id != document_id) {
+        return false;
+    }
+    const uint32_t positions_begin = GetPositionsOffset(block_index, postings.begin(), pos);
+    const uint32_t positions_end = GetPositionsOffset(block_index, postings.begin(), pos + 1);
+    _positions_.erase(_positions_.begin() + positions_begin, _positions_.begin() + positions_end);
+    postings.erase(pos);
+    ReplaceBlock(block_index, postings, it->max_term_freq, it->tag_mask,
+                 -static_cast<int64_t>(positions_end - positions_begin));
+    --size_;
+    return true;
+}
+
+size_t PostingList::Erase(const std::vector<int>& document_ids) {
+    if (document_ids.empty() || GetBlockCount() == 0) {
+        return 0;
+    }
+    MakeOwned();
+    std::vector<Block> blocks;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> positions;
+    blocks.reserve(_blocks_.size());
+    data.reserve(_data_.size());
+    positions.reserve(_positions_.size());
+    std::vector<Posting> kept;
+    size_t erased = 0;
+    auto id_it = document_ids.begin();
+    for (size_t block_index = 0; block_index < _blocks_.size(); ++block_index) {
+        const Block& block = _blocks_[block_index];
+        const bool is_last = block_index + 1 == _blocks_.size();
+        const uint32_t data_end = is_last ? static_cast<uint32_t>(_data_.size()) : _blocks_[block_index + 1].offset;
+        const uint32_t positions_end = is_last ? static_cast<uint32_t>(_positions_.size())
+                                               : _blocks_[block_index + 1].positions_offset;
+        id_it = lower_bound(id_it, document_ids.end(), block.first_id);
+        if (id_it == document_ids.end() || *id_it > block.last_id) {
+            blocks.push_back({block.first_id, block.last_id, static_cast<uint32_t>(data.size()), block.size,
+                              static_cast<uint32_t>(positions.size()), block.tag_mask, block.max_term_freq});
+            data.insert(data.end(), _data_.begin() + block.offset, _data_.begin() + data_end);
+            positions.insert(positions.end(), _positions_.begin() + block.positions_offset,
+                             _positions_.begin() + positions_end);
+            continue;
+        }
+
+        // Записи блока сливаются с удаляемыми id, позиции оставшихся переносятся байтами
+        const uint32_t positions_offset = static_cast<uint32_t>(positions.size());
+        const uint8_t* pos = _positions_.data() + block.positions_offset;
+        kept.clear();
+        for (const Posting& posting : DecodeBlock(block_index)) {
+            const uint8_t* const positions_begin = pos;
+            SkipVarints(posting.count, pos);
+            while (id_it != document_ids.end() && *id_it < posting.document_id) {
+                ++id_it;
+            }
+            if (id_it != document_ids.end() && *id_it == posting.document_id) {
+                ++erased;
+                continue;
+            }
+            kept.push_back(posting);
+            positions.insert(positions.end(), positions_begin, pos);
+        }
+        if (!kept.empty()) {
+            blocks.push_back({kept.front().document_id, kept.back().document_id, static_cast<uint32_t>(data.size()),
+                              static_cast<uint32_t>(kept.size()), positions_offset, block.tag_mask,
+                              block.max_term_freq});
+            EncodePostings(kept.data(), kept.data() + kept.size(), data);
+        }
+    }
+    _blocks_ = std::move(blocks);
+    _data_ = std::move(data);
+    _positions_ = std::move(positions);
+    size_ -= erased;
+    return erased;
+}
+
+PostingList::Iterator PostingList::begin() const {
+    return Iterator(this, 0);
+}
+
+PostingList::Iterator PostingList::end() const {
+    return Iterator(this, GetBlockCount());
+}
+
+size_t PostingList::MemoryUsage() const {
+    return _blocks_.capacity() * sizeof(Block) + _data_.capacity() + _positions_.capacity();
+}
+
+const PostingList::Block* PostingList::GetBlocks() const {
+    return storage_ ? external_blocks_ : _blocks_.data();
+}
+
+size_t PostingList::GetBlockCount() const {
+    return storage_ ? external_block_count_ : _blocks_.size();
+}
+
+const uint8_t* PostingList::GetData() const {
+    return storage_ ? external_data_ : _data_.data();
+}
+
+size_t PostingList::GetDataSize() const {
+    return storage_ ? external_data_size_ : _data_.size();
+}
+
+const uint8_t* PostingList::GetPositionData() const {
+    return storage_ ? external_positions_ : _positions_.data();
+}
+
+size_t PostingList::GetPositionDataSize() const {
+    return storage_ ? external_positions_size_ : _positions_.size();
+}
+
+bool PostingList::IsValidBlockTable(const Block* blocks, size_t block_count, size_t data_size,
+                                    size_t position_data_size, size_t size) {
+    if (block_count == 0) {
+        return size == 0 && data_size == 0 && position_data_size == 0;
+    }
+    if (blocks[0].offset != 0 || blocks[0].positions_offset != 0) {
+        return false;
+    }
+    size_t total_size = 0;
+    for (size_t i = 0; i < block_count; ++i) {
+        const Block& block = blocks[i];
+        // Запись занимает хотя бы байт числа вхождений и байт номера
+        const size_t data_end = i + 1 < block_count ? blocks[i + 1].offset : data_size;
+        const size_t positions_end = i + 1 < block_count ? blocks[i + 1].positions_offset : position_data_size;
+        if (block.size == 0 || block.size > BLOCK_SIZE || block.first_id < 0 || block.first_id > block.last_id
+            || (i + 1 < block_count && block.last_id >= blocks[i + 1].first_id)
+            || data_end > data_size || data_end < block.offset || data_end - block.offset < 2 * size_t{block.size}
+            || positions_end > position_data_size || positions_end < block.positions_offset) {
+            return false;
+        }
+        total_size += block.size;
+    }
+    return total_size == size;
+}
+
+PostingList PostingList::FromExternal(std::shared_ptr<const void> storage,
+                                      const Block* blocks, size_t block_count,
+                                      const uint8_t* data, size_t data_size,
+                                      const uint8_t* position_data, size_t position_data_size,
+                                      size_t size, double max_term_freq) {
+    PostingList result;
+    result.size_ = size;
+    result.max_term_freq_ = max_term_freq;
+    if (block_count > 0) {
+        result.storage_ = std::move(storage);
+        result.external_blocks_ = blocks;
+        result.external_block_count_ = block_count;
+        result.external_data_ = data;
+        result.external_data_size_ = data_size;
+        result.external_positions_ = position_data;
+        result.external_positions_size_ = position_data_size;
+    }
+    return result;
+}
+
+void PostingList::MakeOwned() {
+    if (storage_) {
+        _blocks_.assign(external_blocks_, external_blocks_ + external_block_count_);
+        _data_.assign(external_data_, external_data_ + external_data_size_);
+        _positions_.assign(external_positions_, external_positions_ + external_positions_size_);
+        storage_.reset();
+    }
+}
+
+std::vector<PostingList::Posting> PostingList::DecodeBlock(size_t block_index) const {
+    std::vector<Posting> postings;
+    postings.reserve(_blocks_[block_index].size + 1);
+    Iterator it(this, block_index);
+    for (uint32_t i = 0; i < _blocks_[block_index].size; ++i, ++it) {
+        postings.push_back(*it);
+    }
+    return postings;
+}
+
+uint32_t PostingList::GetPositionsOffset(size_t block_index, std::vector<Posting>::const_iterator first,
+                                         std::vector<Posting>::const_iterator last) const {
+    uint32_t count = 0;
+    for (auto it = first; it != last; ++it) {
+        count += it->count;
+    }
+    const uint8_t* pos = _positions_.data() + _blocks_[block_index].positions_offset;
+    SkipVarints(count, pos);
+    return static_cast<uint32_t>(pos - _positions_.data());
+}
+
+void PostingList::ReplaceBlock(size_t block_index, const std::vector<Posting>& postings, double max_term_freq,
+                               uint32_t tag_mask, int64_t positions_delta) {
+    const uint32_t begin = _blocks_[block_index].offset;
+    const uint32_t end = block_index + 1 < _blocks_.size() ? _blocks_[block_index + 1].offset
+                                                          : static_cast<uint32_t>(_data_.size());
+    // Переполненный блок делится пополам
+    const size_t chunk = postings.size() > BLOCK_SIZE ? (postings.size() + 1) / 2 : BLOCK_SIZE;
+    std::vector<Block> blocks;
+    std::vector<uint8_t> bytes;
+    uint32_t positions_offset = _blocks_[block_index].positions_offset;
+    for (size_t first = 0; first < postings.size(); first += chunk) {
+        const size_t last = std::min(first + chunk, postings.size());
+        blocks.push_back({postings[first].document_id, postings[last - 1].document_id,
+                          static_cast<uint32_t>(begin + bytes.size()), static_cast<uint32_t>(last - first),
+                          positions_offset, tag_mask, max_term_freq});
+        EncodePostings(postings.data() + first, postings.data() + last, bytes);
+        if (last < postings.size()) {
+            const uint8_t* pos = _positions_.data() + positions_offset;
+            uint32_t count = 0;
+            for (size_t i = first; i < last; ++i) {
+                count += postings[i].count;
+            }
+            SkipVarints(count, pos);
+            positions_offset = static_cast<uint32_t>(pos - _positions_.data());
+        }
+    }
+
+    const uint32_t old_size = end - begin;
+    const uint32_t new_size = static_cast<uint32_t>(bytes.size());
+    for (size_t i = block_index + 1; i < _blocks_.size(); ++i) {
+        _blocks_[i].offset = _blocks_[i].offset - old_size + new_size;
+        _blocks_[i].positions_offset = static_cast<uint32_t>(_blocks_[i].positions_offset + positions_delta);
+    }
+    _data_.erase(_data_.begin() + begin, _data_.begin() + end);
+    _data_.insert(_data_.begin() + begin, bytes.begin(), bytes.end());
+    _blocks_.erase(_blocks_.begin() + block_index);
+    _blocks_.insert(_blocks_.begin() + block_index, blocks.begin(), blocks.end());
+}
+
+void PostingList::EncodePostings(const Posting* first, const Posting* last, std::vector<uint8_t>& out) {
+    PutVarint(first->count, out);
+    PutVarint(first->ordinal, out);
+    for (const Posting* it = first + 1; it != last; ++it) {
+        PutVarint(static_cast<uint32_t>(it->document_id - (it - 1)->document_id), out);
+        PutVarint(it->count, out);
+        PutVarint(it->ordinal, out);
+    }
+}
+
+void PostingList::EncodePositions(const Posting* first, const Posting* last, const uint32_t* positions,
+                                  std::vector<uint8_t>& out) {
+    for (const Posting* it = first; it != last; ++it) {
+        uint32_t previous = 0;
+        for (uint32_t i = 0; i < it->count; ++i, ++positions) {
+            PutVarint(*positions - previous, out);
+            previous = *positions;
+        }
+    }
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+// Список вхождений (posting list) одного слова.
+// Id документов хранятся отсортированными, блоками по BLOCK_SIZE записей:
+// внутри блока - разности соседних id, число вхождений слова и внутренний номер
+// документа в индексе (ordinal, см. DocumentOrdinals), все в varint. Номер позволяет
+// читать столбцы атрибутов документа без поиска по id.
+// Для каждого блока хранится первый и последний id, что позволяет
+// пропускать блоки целиком и вставлять id не по порядку, верхняя граница
+// TF слова в документах блока (для отсечения в WAND) и маска меток документов
+// блока: SearchServer помечает запись битом статуса документа и пропускает
+// блоки без документов нужного статуса, не декодируя их.
+// Позиции слова в документах (номера среди слов документа без стоп-слов)
+// хранятся отдельным потоком байт: для каждой записи count позиций,
+// первая и разности соседних в varint; итератор декодирует их только по запросу.
+// Таблица блоков и байты записей могут находиться во внешней памяти
+// (отображённый файл индекса), тогда они копируются при первом изменении.
+class PostingList
+{
+public:
+    static constexpr uint32_t BLOCK_SIZE = 128;
+
+    struct Posting {
+        int document_id = 0;
+        uint32_t count = 0;     // сколько раз слово встречается в документе
+        uint32_t ordinal = 0;   // внутренний номер документа в индексе-владельце списка
+    };
+
+    // Запись таблицы блоков, хранится в файле индекса как есть
+    struct Block {
+        int first_id;
+        int last_id;
+        uint32_t offset;            // начало блока в байтах записей
+        uint32_t size;              // число записей
+        uint32_t positions_offset;  // начало позиций блока в байтах позиций
+        uint32_t tag_mask;          // объединение меток записей; после удалений и Append - надмножество
+        double max_term_freq;
+    };
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Posting;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Posting*;
+        using reference = const Posting&;
+
+        Iterator() = default;
+
+        reference operator*() const {
+            return current_;
+        }
+        pointer operator->() const {
+            return &current_;
+        }
+
+        Iterator& operator++();
+        Iterator operator++(int);
+
+        bool operator==(const Iterator& other) const {
+            return block_index_ == other.block_index_ && left_in_block_ == other.left_in_block_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        // Переход к первой записи с id >= document_id, блоки с меньшими id не декодируются
+        void SkipTo(int document_id);
+
+        // Переход к первой записи следующего блока
+        void NextBlock();
+
+        // Маска меток текущего блока
+        uint32_t GetBlockTagMask() const {
+            return blocks_[block_index_].tag_mask;
+        }
+
+        // Наибольший id текущего блока
+        int GetBlockLastId() const {
+            return blocks_[block_index_].last_id;
+        }
+
+        struct BlockBound {
+            int last_id;
+            double max_term_freq;
+            uint32_t tag_mask;
+        };
+
+        // Граница блока, в который попадёт SkipTo(document_id), без перемещения итератора.
+        // Если такого блока нет, last_id = INT_MAX, max_term_freq = 0 и tag_mask = 0.
+        BlockBound GetBlockBound(int document_id) const;
+
+        // Позиции слова в текущем документе по возрастанию (count штук)
+        void GetPositions(std::vector<uint32_t>& positions);
+
+    private:
+        friend class PostingList;
+
+        Iterator(const PostingList* list, size_t block_index);
+
+        void LoadBlock();
+
+        const Block* blocks_ = nullptr;
+        size_t block_count_ = 0;
+        const uint8_t* data_ = nullptr;
+        const uint8_t* positions_ = nullptr;
+        size_t block_index_ = 0;
+        const uint8_t* pos_ = nullptr;
+        uint32_t left_in_block_ = 0;    // записей блока после текущей
+        Posting current_;
+        // Позиции текущей записи начинаются после skip_positions_ позиций от positions_pos_
+        const uint8_t* positions_pos_ = nullptr;
+        uint32_t skip_positions_ = 0;
+    };
+
+    // id документа не должен уже присутствовать в списке, ordinal - его внутренний номер,
+    // tag_mask - метки документа, добавляются к маске блока;
+    // positions - позиции слова в документе по возрастанию, их число - число вхождений;
+    // term_freq - TF слова в документе, используется только для верхних границ
+    void Add(int document_id, uint32_t ordinal, uint32_t tag_mask, const std::vector<uint32_t>& positions,
+             double term_freq);
+
+    // Дописывает записи other, если все его id больше id списка: неполный последний блок
+    // списка дополняется первыми записями other, остальные блоки other переносятся байтами
+    // без перекодирования. Иначе возвращает false, список не меняется
+    bool Append(PostingList&& other);
+
+    bool Erase(int document_id);
+
+    // Удаляет документы document_ids (по возрастанию) за один проход по списку:
+    // блоки без удаляемых id копируются байтами, остальные перекодируются один раз.
+    // Возвращает число удалённых записей
+    size_t Erase(const std::vector<int>& document_ids);
+
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Верхняя граница TF слова по всему списку. При удалении документов
+    // границы не уменьшаются и остаются корректными, хотя и менее точными.
+    double MaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    // IDF слова в корпусе из document_count документов, список не пуст.
+    // Значение кешируется в списке и пересчитывается, только если изменились
+    // document_count или size(); вызовы из нескольких потоков допустимы.
+    double GetInverseDocumentFreq(int document_count) const {
+        const uint64_t key = uint64_t{static_cast<uint32_t>(document_count)} << 32 | static_cast<uint32_t>(size_);
+        uint64_t cached_key = 0;
+        double cached_value = 0.0;
+        if (idf_cache_.Load(cached_key, cached_value) && cached_key == key) {
+            return cached_value;
+        }
+        // Та же формула, что в SearchServer::ComputeInverseDocumentFreq
+        const double value = std::log(document_count * 1.0 / size_);
+        idf_cache_.Store(key, value);
+        return value;
+    }
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    // Байты, занимаемые списком в куче (с учётом резерва векторов), внешняя память не учитывается
+    size_t MemoryUsage() const;
+
+    // Таблица блоков, байты записей и байты позиций - для записи в файл индекса
+    const Block* GetBlocks() const;
+    size_t GetBlockCount() const;
+    const uint8_t* GetData() const;
+    size_t GetDataSize() const;
+    const uint8_t* GetPositionData() const;
+    size_t GetPositionDataSize() const;
+
+    // Согласована ли таблица блоков внешних данных: блоки не пусты, не больше BLOCK_SIZE записей
+    // и идут по возрастанию id, их байты записей и позиций идут подряд с начала и лежат
+    // в пределах data_size и position_data_size, записей всего size. Байты внутри блоков
+    // не проверяются - для этого нужен их полный разбор
+    static bool IsValidBlockTable(const Block* blocks, size_t block_count, size_t data_size,
+                                  size_t position_data_size, size_t size);
+
+    // Список над внешней памятью, которую storage держит, пока она нужна списку или его копиям
+    static PostingList FromExternal(std::shared_ptr<const void> storage,
+                                    const Block* blocks, size_t block_count,
+                                    const uint8_t* data, size_t data_size,
+                                    const uint8_t* position_data, size_t position_data_size,
+                                    size_t size, double max_term_freq);
+
+private:
+    std::vector<Block> _blocks_;
+    std::vector<uint8_t> _data_;
+    std::vector<uint8_t> _positions_;
+    size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+
+    // Кеш GetInverseDocumentFreq: значение для key = (document_count << 32 | size), 0 - пусто.
+    // Пара согласуется счётчиком записей (seqlock): на время записи он нечётный, чтение
+    // принимает пару, только если счётчик был чётным и не изменился. Пишет один поток:
+    // остальные, застав запись, не сохраняют своё значение (потоки с разными document_count
+    // иначе могли бы оставить ключ одного вместе со значением другого)
+    struct InverseDocumentFreqCache {
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint64_t> key{0};
+        std::atomic<double> value{0.0};
+
+        InverseDocumentFreqCache() = default;
+        InverseDocumentFreqCache(const InverseDocumentFreqCache& other) noexcept {
+            *this = other;
+        }
+        // Копируемый список может читаться другими потоками. noexcept - чтобы vector<PostingList>
+        // при росте перемещал списки, а не копировал
+        InverseDocumentFreqCache& operator=(const InverseDocumentFreqCache& other) noexcept {
+            uint64_t other_key = 0;
+            double other_value = 0.0;
+            if (!other.Load(other_key, other_value)) {
+                other_key = 0;
+            }
+            Store(other_key, other_value);
+            return *this;
+        }
+
+        // false, если пара в это время записывалась
+        bool Load(uint64_t& result_key, double& result_value) const noexcept {
+            const uint32_t begin = sequence.load(std::memory_order_acquire);
+            if (begin % 2 != 0) {
+                return false;
+            }
+            // Загрузки acquire не переставляются с повторным чтением счётчика
+            result_key = key.load(std::memory_order_acquire);
+            result_value = value.load(std::memory_order_acquire);
+            return sequence.load(std::memory_order_relaxed) == begin;
+        }
+
+        void Store(uint64_t new_key, double new_value) noexcept {
+            uint32_t begin = sequence.load(std::memory_order_relaxed);
+            if (begin % 2 != 0
+                || !sequence.compare_exchange_strong(begin, begin + 1, std::memory_order_relaxed)) {
+                return;
+            }
+            // Записи release видны читателю только вместе с нечётным счётчиком
+            key.store(new_key, std::memory_order_release);
+            value.store(new_value, std::memory_order_release);
+            sequence.store(begin + 2, std::memory_order_release);
+        }
+    };
+    mutable InverseDocumentFreqCache idf_cache_;
+
+    // Внешние данные; пока storage_ задан, _blocks_, _data_ и _positions_ пусты
+    std::shared_ptr<const void> storage_;
+    const Block* external_blocks_ = nullptr;
+    size_t external_block_count_ = 0;
+    const uint8_t* external_data_ = nullptr;
+    size_t external_data_size_ = 0;
+    const uint8_t* external_positions_ = nullptr;
+    size_t external_positions_size_ = 0;
+
+    // Копирует внешние данные в собственные векторы перед изменением
+    void MakeOwned();
+
+    std::vector<Posting> DecodeBlock(size_t block_index) const;
+
+    // Смещение в байтах позиций, с которого начинаются позиции записи last блока block_index;
+    // first..last - записи блока от его начала
+    uint32_t GetPositionsOffset(size_t block_index, std::vector<Posting>::const_iterator first,
+                                std::vector<Posting>::const_iterator last) const;
+
+    // Заменяет блок block_index закодированными postings (пустой набор - удаление блока),
+    // новые блоки получают границу TF max_term_freq и маску tag_mask. Байты позиций блока
+    // уже изменены вызывающим, их размер изменился на positions_delta.
+    void ReplaceBlock(size_t block_index, const std::vector<Posting>& postings, double max_term_freq,
+                      uint32_t tag_mask, int64_t positions_delta);
+
+    static void EncodePostings(const Posting* first, const Posting* last, std::vector<uint8_t>& out);
+
+    // Позиции записей [first, last), positions - их позиции подряд
+    static void EncodePositions(const Posting* first, const Posting* last, const uint32_t* positions,
+                                std::vector<uint8_t>& out);
+};
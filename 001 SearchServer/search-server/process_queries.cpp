@@ -1,30 +1,69 @@
+#include <numeric>
+
 #include "process_queries.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server, const std::vector<std::string>& queries) {
 
-    std::vector<std::vector<Document>> documents(queries.size());
+    // Пакетное выполнение вместо вложенного распараллеливания по запросам и внутри запроса
+    return search_server.FindTopDocumentsBatch(std::execution::par,
+                                               queries,
+                                               [](int, DocumentStatus, int) {
+                                                   return true;
+                                               });
+}
+
+JoinedDocuments::JoinedDocuments(const std::vector<std::vector<Document>>& documents_lists) {
+    // Смещения результатов запросов - префиксные суммы их размеров
+    _offsets_.resize(documents_lists.size() + 1);
+    std::transform_inclusive_scan(documents_lists.begin(), documents_lists.end(),
+                                  _offsets_.begin() + 1,
+                                  std::plus<>(),
+                                  [](const std::vector<Document>& documents) { return documents.size(); });
+    _documents_.resize(_offsets_.back());
+
+    // Каждый поток копирует в свой участок буфера, синхронизация не нужна
+    std::vector<size_t> query_indexes(documents_lists.size());
+    std::iota(query_indexes.begin(), query_indexes.end(), 0);
+    std::for_each(std::execution::par,
+                  query_indexes.begin(), query_indexes.end(),
+                  [this, &documents_lists](const size_t query_index) {
+                      std::copy(documents_lists[query_index].begin(), documents_lists[query_index].end(),
+                                _documents_.begin() + _offsets_[query_index]);
+    });
+}
+
+JoinedDocuments::Iterator JoinedDocuments::begin() const {
+    return _documents_.begin();
+}
+
+JoinedDocuments::Iterator JoinedDocuments::end() const {
+    return _documents_.end();
+}
+
+size_t JoinedDocuments::size() const {
+    return _documents_.size();
+}
+
+bool JoinedDocuments::empty() const {
+    return _documents_.empty();
+}
+
+const Document& JoinedDocuments::operator[](size_t index) const {
+    return _documents_[index];
+}
+
+size_t JoinedDocuments::GetQueryCount() const {
+    return _offsets_.size() - 1;
+}
 
-    transform(std::execution::par,
-        queries.begin(),
-        queries.end(),
-        documents.begin(),
-        [&search_server](const std::string_view query) {
-           return search_server.SearchServer::FindTopDocuments(std::execution::par, query);
-  });
-    return documents;
+IteratorRange<JoinedDocuments::Iterator> JoinedDocuments::GetQueryDocuments(size_t query_index) const {
+    return IteratorRange(_documents_.begin() + _offsets_.at(query_index),
+                         _documents_.begin() + _offsets_.at(query_index + 1));
 }
 
-std::list<Document> ProcessQueriesJoined(
+JoinedDocuments ProcessQueriesJoined(
     const SearchServer& search_server, const std::vector<std::string>& queries) {
 
-    std::list<Document> documents;
-    for (auto&& __doc : ProcessQueries(search_server, queries)) {
-        tbb::blocked_range range(__doc.begin(), __doc.end());
-        tbb::parallel_for(range,
-                          [&documents](auto&& _doc) {
-                              documents.insert(documents.end(), _doc.begin(), _doc.end());
-        });
-    }
-    return documents;
+    return JoinedDocuments(ProcessQueries(search_server, queries));
 }
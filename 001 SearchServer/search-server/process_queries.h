@@ -1,11 +1,65 @@
 #pragma once
 
+#include <algorithm>
+#include <execution>
+#include <string>
+#include <vector>
+
 #include "document.h"
+#include "paginator.h"
 #include "search_server.h"
 
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(
+// Результаты всех запросов подряд в одном непрерывном буфере, в порядке запросов
+class JoinedDocuments
+{
+public:
+    using Iterator = std::vector<Document>::const_iterator;
+
+    JoinedDocuments() = default;
+    explicit JoinedDocuments(const std::vector<std::vector<Document>>& documents_lists);
+
+    Iterator begin() const;
+    Iterator end() const;
+    size_t size() const;
+    bool empty() const;
+    const Document& operator[](size_t index) const;
+
+    size_t GetQueryCount() const;
+    // Документы запроса query_index
+    IteratorRange<Iterator> GetQueryDocuments(size_t query_index) const;
+
+private:
+    std::vector<Document> _documents_;
+    std::vector<size_t> _offsets_{0};   // документы запроса i - [_offsets_[i], _offsets_[i + 1])
+};
+
+JoinedDocuments ProcessQueriesJoined(
     const SearchServer& search_server, const std::vector<std::string>& queries);
+
+// Потоковый вариант ProcessQueriesJoined: sink(document) вызывается для документов
+// всех запросов в порядке запросов. Запросы выполняются пакетами по batch_size,
+// в памяти одновременно только результаты одного пакета.
+template <typename DocumentSink>
+void ProcessQueriesStreamed(const SearchServer& search_server, const std::vector<std::string>& queries,
+                            DocumentSink sink, size_t batch_size = 1024) {
+    batch_size = std::max<size_t>(batch_size, 1);
+    for (auto it = queries.begin(); it != queries.end();) {
+        const auto batch_end = it + std::min<size_t>(batch_size, queries.end() - it);
+        const auto documents_lists =
+            search_server.FindTopDocumentsBatch(std::execution::par,
+                                                IteratorRange(it, batch_end),
+                                                [](int, DocumentStatus, int) {
+                                                    return true;
+                                                });
+        for (const std::vector<Document>& documents : documents_lists) {
+            for (const Document& document : documents) {
+                sink(document);
+            }
+        }
+        it = batch_end;
+    }
+}
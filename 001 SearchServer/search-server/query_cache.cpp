@@ -0,0 +1,81 @@
+#include "query_cache.h"
+
+using namespace std;
+
+QueryCache::QueryCache(size_t capacity, size_t shard_count)
+    : capacity_(capacity)
+{
+    if (capacity == 0) {
+        return;
+    }
+    size_t count = 1;
+    while (count < shard_count && count * 2 <= capacity) {
+        count *= 2;
+    }
+    _shards_ = std::vector<Shard>(count);
+    // Остаток распределяется по одной записи, сумма ёмкостей шардов - ровно capacity
+    for (size_t i = 0; i < count; ++i) {
+        _shards_[i].capacity = capacity / count + (i < capacity % count ? 1 : 0);
+    }
+}
+
+QueryCache::QueryCache(const QueryCache& other)
+    : QueryCache(other.capacity_, other._shards_.size())
+{}
+
+QueryCache& QueryCache::operator=(const QueryCache& other) {
+    if (this != &other) {
+        *this = QueryCache(other);
+    }
+    return *this;
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(std::string_view key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    lock_guard guard(shard.mutex);
+    const auto it = shard._key_to_entry_.find(key);
+    if (it == shard._key_to_entry_.end()) {
+        ++shard.misses;
+        return nullopt;
+    }
+    const auto entry = it->second;
+    if (entry->generation != generation) {
+        // Выдача вычислена до изменения индекса
+        shard._key_to_entry_.erase(it);
+        shard.entries.erase(entry);
+        ++shard.misses;
+        return nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    ++shard.hits;
+    return entry->documents;
+}
+
+void QueryCache::Insert(std::string_view key, uint64_t generation, const std::vector<Document>& documents) {
+    Shard& shard = GetShard(key);
+    lock_guard guard(shard.mutex);
+    const auto it = shard._key_to_entry_.find(key);
+    if (it != shard._key_to_entry_.end()) {
+        // Запрос одновременно выполнялся в нескольких потоках
+        it->second->generation = generation;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    if (shard.entries.size() == shard.capacity) {
+        shard._key_to_entry_.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({std::string(key), generation, documents});
+    shard._key_to_entry_.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    Stats result;
+    for (const Shard& shard : _shards_) {
+        lock_guard guard(shard.mutex);
+        result.hits += shard.hits;
+        result.misses += shard.misses;
+    }
+    return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+// Кеш результатов запросов: LRU, разбитый на шарды. Ключ - нормализованный
+// разобранный запрос (см. SearchServer::BuildQueryCacheKey), значение - выдача
+// и поколение индекса, в котором она вычислена. Запись другого поколения -
+// промах, она удаляется при поиске, поэтому изменение индекса сводится к
+// увеличению счётчика поколений. Шард - список записей от недавних к давним и
+// хеш-таблица ключ -> запись под собственным мьютексом: попадание переносит
+// запись в начало списка, поэтому и чтение блокирует шард на запись.
+// Шарды выровнены по кеш-линии, как в ConcurrentMap.
+class QueryCache
+{
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries;       // от недавно использованных к давним
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> _key_to_entry_;   // ключи - строки записей
+        size_t capacity = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+public:
+    static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // Отключённый кеш
+    QueryCache() = default;
+
+    // capacity - число запросов, делится между шардами; 0 - кеш отключён. Число шардов -
+    // степень двойки, не меньшая shard_count, но не больше capacity
+    explicit QueryCache(size_t capacity, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    // Копия - пустой кеш той же ёмкости
+    QueryCache(const QueryCache& other);
+    QueryCache& operator=(const QueryCache& other);
+
+    QueryCache(QueryCache&&) = default;
+    QueryCache& operator=(QueryCache&&) = default;
+
+    bool IsEnabled() const {
+        return !_shards_.empty();
+    }
+
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+
+    // Выдача по ключу, если она вычислена в поколении generation
+    std::optional<std::vector<Document>> Find(std::string_view key, uint64_t generation);
+
+    // Сохраняет выдачу, вытесняя давно использованную запись заполненного шарда
+    void Insert(std::string_view key, uint64_t generation, const std::vector<Document>& documents);
+
+    // Не атомарна относительно параллельных запросов к разным шардам
+    Stats GetStats() const;
+
+private:
+    size_t capacity_ = 0;
+    std::vector<Shard> _shards_;    // пустой - кеш отключён
+
+    Shard& GetShard(std::string_view key) {
+        return _shards_[std::hash<std::string_view>{}(key) & (_shards_.size() - 1)];
+    }
+};
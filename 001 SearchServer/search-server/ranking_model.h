@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+// Нормы длины документа, вычисляются один раз в AddDocument
+struct DocumentNorms {
+    double word_count;          // число слов документа без стоп-слов
+    double inv_word_count;      // 1 / word_count, TF слова = число вхождений * inv_word_count
+};
+
+// Статистика корпуса, от которой зависят веса модели ранжирования
+struct CorpusStatistics {
+    int document_count = 0;
+    int64_t word_count = 0;     // сумма word_count всех документов
+};
+
+// Модели ранжирования - параметр шаблона FindTopDocuments.
+// Релевантность документа - сумма вкладов плюс-слов запроса. Модель создаётся
+// на запрос по статистике корпуса и предоставляет:
+//   Score(idf, count, norms)          - вклад слова с IDF idf, встреченного count раз
+//                                       в документе с нормами norms;
+//   UpperBound(idf, max_term_freq)    - не меньше Score для любого документа,
+//                                       где count * norms.inv_word_count <= max_term_freq
+//                                       (границы блоков posting list для WAND).
+// Score вычисляется для каждого найденного вхождения и не содержит ветвлений.
+// BM25F (BM25 с весами полей) нет: документ - один текст без полей, и posting lists
+// не различают, в каком поле встретилось слово.
+
+// TF-IDF: TF * IDF, TF = count / word_count
+class TfIdfRanking
+{
+public:
+    explicit TfIdfRanking(const CorpusStatistics&) {}
+
+    double Score(double idf, uint32_t count, const DocumentNorms& norms) const {
+        return count * norms.inv_word_count * idf;
+    }
+
+    double UpperBound(double idf, double max_term_freq) const {
+        return max_term_freq * idf;
+    }
+};
+
+// Okapi BM25 с IDF = log(N / df):
+// IDF * count * (K1 + 1) / (count + K1 * (1 - B + B * word_count / средний word_count))
+class Bm25Ranking
+{
+public:
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    explicit Bm25Ranking(const CorpusStatistics& statistics)
+        : length_factor_(statistics.word_count > 0
+                         ? K1 * B * statistics.document_count / statistics.word_count
+                         : 0.0)
+    {}
+
+    double Score(double idf, uint32_t count, const DocumentNorms& norms) const {
+        return idf * (count * (K1 + 1)) / (count + K1 * (1 - B) + length_factor_ * norms.word_count);
+    }
+
+    // count / (count + K1 * (1 - B) + length_factor_ * word_count) < tf / (tf + length_factor_),
+    // где tf = count / word_count, а правая часть растёт с tf
+    double UpperBound(double idf, double max_term_freq) const {
+        return idf * (K1 + 1) * (max_term_freq / (max_term_freq + length_factor_));
+    }
+
+private:
+    double length_factor_;      // K1 * B / средний word_count
+};
@@ -1,39 +1,89 @@
 #include <algorithm>
-#include <iostream>
-#include <string>
-#include <vector>
-#include <utility>
-#include <iterator>
-#include <map>
-#include <set>
-#include <utility>
-
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 #include "remove_duplicates.h"
-#include "log_duration.h"
 
+using namespace std;
 
-void RemoveDuplicates(SearchServer& search_server)
+DuplicateDetector::DuplicateDetector(double jaccard_threshold, int signature_size)
+    : jaccard_threshold_(jaccard_threshold)
 {
-    //LOG_DURATION("RemoveDupl - O(wN(log⁡N+log⁡W))"s);
-    std::vector<int> v_dubl_ids;
-    std::set<std::set<std::string>> words_to_id_;
-
-    for (const int document_id : search_server)
-    {
-        std::set<std::string> words_;
-        for (const auto& word_freq : search_server.GetWordFrequencies(document_id))
-            words_.insert(word_freq.first);
-
-        if (!words_to_id_.emplace(words_).second)
-            v_dubl_ids.push_back(document_id);
+    if (!(jaccard_threshold > 0.0 && jaccard_threshold <= 1.0)) {
+        throw invalid_argument("Jaccard threshold must be in (0, 1]"s);
+    }
+    if (signature_size <= 0) {
+        throw invalid_argument("Signature size must be positive"s);
     }
+    // Наибольшее число строк r при band_count = signature_size / r, для которого
+    // вероятность совпадения хотя бы одной полосы 1 - (1 - t^r)^band_count при t = порогу
+    // не меньше MIN_CANDIDATE_PROBABILITY; больше строк - меньше лишних кандидатов
+    rows_per_band_ = 1;
+    for (int rows = 1; rows <= signature_size; ++rows) {
+        const int bands = signature_size / rows;
+        const double probability = 1.0 - pow(1.0 - pow(jaccard_threshold, rows), bands);
+        if (probability >= MIN_CANDIDATE_PROBABILITY) {
+            rows_per_band_ = rows;
+        }
+    }
+    band_count_ = signature_size / rows_per_band_;
+}
 
-    //LOG_DURATION("RemoveDoc - n * O(w(log⁡N+log⁡W))"s);
-    sort(v_dubl_ids.begin(), v_dubl_ids.end());
-    for (const auto id : v_dubl_ids)
-    {
-        std::cout << "Found duplicate document id "s << id << std::endl;
-        search_server.RemoveDocument(id);
+// Финализатор splitmix64
+uint64_t DuplicateDetector::Mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+uint64_t DuplicateDetector::HashTermSet(const TermSet& terms) {
+    uint64_t hash = Mix(terms.size());
+    for (const TermId term_id : terms) {
+        hash = Mix(hash ^ term_id);
     }
+    return hash;
+}
+
+void DuplicateDetector::ComputeSignature(const TermSet& terms, uint32_t* signature) const {
+    // i-я хеш-функция слова - a + i * b (двойное хеширование), a и b - половины хеша id слова
+    const size_t signature_size = static_cast<size_t>(band_count_) * rows_per_band_;
+    fill(signature, signature + signature_size, numeric_limits<uint32_t>::max());
+    for (const TermId term_id : terms) {
+        const uint64_t hash = Mix(term_id);
+        const uint32_t a = static_cast<uint32_t>(hash);
+        const uint32_t b = static_cast<uint32_t>(hash >> 32) | 1;
+        uint32_t value = a;
+        for (size_t i = 0; i < signature_size; ++i) {
+            signature[i] = min(signature[i], value);
+            value += b;
+        }
+    }
+}
+
+bool DuplicateDetector::IsSimilar(const TermSet& lhs, const TermSet& rhs) const {
+    // |A ∩ B| / |A ∪ B| >= t, при этом min(|A|, |B|) / max(|A|, |B|) >= t
+    const size_t min_size = min(lhs.size(), rhs.size());
+    const size_t max_size = max(lhs.size(), rhs.size());
+    if (min_size < jaccard_threshold_ * max_size) {
+        return false;
+    }
+    size_t common = 0;
+    for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end() && rhs_it != rhs.end();) {
+        if (*lhs_it < *rhs_it) {
+            ++lhs_it;
+        } else if (*rhs_it < *lhs_it) {
+            ++rhs_it;
+        } else {
+            ++common;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return common >= jaccard_threshold_ * (lhs.size() + rhs.size() - common);
+}
+
+void RemoveDuplicates(SearchServer& search_server) {
+    RemoveDuplicates(execution::seq, search_server);
 }
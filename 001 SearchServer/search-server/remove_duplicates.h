@@ -1,10 +1,270 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <numeric>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "search_server.h"
 
 using namespace std::string_literals;
 
+// Поиск дубликатов документов SearchServer по множествам слов (id слов словаря индекса).
+// Точный режим: дубликаты - документы с одинаковыми множествами слов; множества
+// сравниваются по 64-битному хешу, совпадения хешей проверяются сравнением множеств.
+// Режим почти-дубликатов: документ - дубликат, если сходство Жаккара его множества
+// слов с множеством не удалённого документа с меньшим id не меньше порога.
+// Кандидаты отбираются MinHash/LSH: сигнатура из signature_size минимальных хешей
+// делится на полосы, документы с совпавшей полосой - кандидаты, и для них
+// сходство вычисляется точно. Документы, не попавшие вместе ни в одну полосу,
+// не сравниваются, поэтому часть почти-дубликатов может быть пропущена;
+// число строк в полосе выбирается так, чтобы пара со сходством, равным порогу,
+// становилась кандидатом с вероятностью не меньше MIN_CANDIDATE_PROBABILITY.
+// В полосе, совпавшей у многих попарно непохожих документов, документ сравнивается
+// только с первыми из них (см. FindNearDuplicates) - время остаётся линейным.
+class DuplicateDetector
+{
+public:
+    static constexpr double MIN_CANDIDATE_PROBABILITY = 0.95;
+
+    // Точные дубликаты
+    DuplicateDetector() = default;
+
+    // Почти-дубликаты, 0 < jaccard_threshold <= 1
+    explicit DuplicateDetector(double jaccard_threshold, int signature_size = 128);
+
+    // id дубликатов по возрастанию; из каждой группы дубликатов остаётся документ с наименьшим id
+    template <typename ExecutionPolicy>
+    std::vector<int> FindDuplicates(ExecutionPolicy&& policy, const SearchServer& search_server) const;
+
+private:
+    using TermId = SearchServer::TermId;
+    using TermSet = IteratorRange<ForwardIndex::TermIterator>;   // id слов по возрастанию
+
+    double jaccard_threshold_ = 1.0;    // 1 - точный режим
+    int band_count_ = 0;
+    int rows_per_band_ = 0;
+
+    static uint64_t Mix(uint64_t value);
+
+    static uint64_t HashTermSet(const TermSet& terms);
+
+    // Сигнатура MinHash: band_count_ * rows_per_band_ значений
+    void ComputeSignature(const TermSet& terms, uint32_t* signature) const;
+
+    bool IsSimilar(const TermSet& lhs, const TermSet& rhs) const;
+
+    // Индексы в _documents точных дубликатов; is_duplicate[i] отмечает их
+    template <typename ExecutionPolicy>
+    static void FindExactDuplicates(ExecutionPolicy&& policy, const std::vector<TermSet>& _documents,
+                                    std::vector<char>& is_duplicate);
+
+    // Отмечает в is_duplicate почти-дубликаты среди ещё не отмеченных документов
+    template <typename ExecutionPolicy>
+    void FindNearDuplicates(ExecutionPolicy&& policy, const std::vector<TermSet>& _documents,
+                            std::vector<char>& is_duplicate) const;
+};
+
+// Удаляет точные дубликаты, сообщая в cout об удалении каждого
 void RemoveDuplicates(SearchServer& search_server);
+
+// Удаляет дубликаты, найденные detector, одним вызовом RemoveDocuments
+template <typename ExecutionPolicy>
+void RemoveDuplicates(ExecutionPolicy&& policy, SearchServer& search_server,
+                      const DuplicateDetector& detector = DuplicateDetector());
+
+
+template <typename ExecutionPolicy>
+std::vector<int> DuplicateDetector::FindDuplicates(ExecutionPolicy&& policy, const SearchServer& search_server) const {
+
+    // Документы по возрастанию id
+    std::vector<int> _ids;
+    std::vector<TermSet> _documents;
+    _ids.reserve(search_server.GetDocumentCount());
+    _documents.reserve(search_server.GetDocumentCount());
+    for (const int document_id : search_server) {
+        _ids.push_back(document_id);
+        _documents.push_back(search_server._forward_index_.GetTerms(search_server._ordinals_.Find(document_id)));
+    }
+
+    std::vector<char> is_duplicate(_documents.size(), false);
+    FindExactDuplicates(policy, _documents, is_duplicate);
+    if (jaccard_threshold_ < 1.0) {
+        FindNearDuplicates(policy, _documents, is_duplicate);
+    }
+
+    std::vector<int> _duplicate_ids;
+    for (size_t i = 0; i < _documents.size(); ++i) {
+        if (is_duplicate[i]) {
+            _duplicate_ids.push_back(_ids[i]);
+        }
+    }
+    return _duplicate_ids;
+}
+
+template <typename ExecutionPolicy>
+void DuplicateDetector::FindExactDuplicates(ExecutionPolicy&& policy, const std::vector<TermSet>& _documents,
+                                            std::vector<char>& is_duplicate) {
+
+    // (хеш множества слов, индекс документа); при равных хешах индексы по возрастанию
+    std::vector<std::pair<uint64_t, uint32_t>> _hashes(_documents.size());
+    std::vector<uint32_t> indexes(_documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy,
+                  indexes.begin(), indexes.end(),
+                  [&](const uint32_t index) {
+                      _hashes[index] = {HashTermSet(_documents[index]), index};
+    });
+    std::sort(policy, _hashes.begin(), _hashes.end());
+
+    // В группе равных хешей документ - дубликат, если его множество совпадает
+    // с множеством одного из предыдущих оставленных документов группы
+    std::vector<uint32_t> _kept;
+    for (size_t begin = 0, end = 0; begin < _hashes.size(); begin = end) {
+        for (end = begin + 1; end < _hashes.size() && _hashes[end].first == _hashes[begin].first; ++end) {}
+        _kept.clear();
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t index = _hashes[i].second;
+            const bool is_copy = std::any_of(_kept.begin(), _kept.end(), [&](const uint32_t kept_index) {
+                return std::equal(_documents[kept_index].begin(), _documents[kept_index].end(),
+                                  _documents[index].begin(), _documents[index].end());
+            });
+            if (is_copy) {
+                is_duplicate[index] = true;
+            } else {
+                _kept.push_back(index);
+            }
+        }
+    }
+}
+
+template <typename ExecutionPolicy>
+void DuplicateDetector::FindNearDuplicates(ExecutionPolicy&& policy, const std::vector<TermSet>& _documents,
+                                           std::vector<char>& is_duplicate) const {
+
+    // Сравниваются только документы, оставшиеся после точного поиска
+    std::vector<uint32_t> _candidates;
+    for (uint32_t index = 0; index < _documents.size(); ++index) {
+        if (!is_duplicate[index]) {
+            _candidates.push_back(index);
+        }
+    }
+
+    const size_t signature_size = static_cast<size_t>(band_count_) * rows_per_band_;
+    std::vector<uint32_t> _signatures(_candidates.size() * signature_size);
+    // (хеш полосы сигнатуры, индекс документа) для каждой полосы каждого документа
+    std::vector<std::pair<uint64_t, uint32_t>> _band_hashes(_candidates.size() * band_count_);
+    std::vector<uint32_t> positions(_candidates.size());
+    std::iota(positions.begin(), positions.end(), 0);
+    std::for_each(policy,
+                  positions.begin(), positions.end(),
+                  [&](const uint32_t position) {
+                      const uint32_t index = _candidates[position];
+                      uint32_t* signature = _signatures.data() + position * signature_size;
+                      ComputeSignature(_documents[index], signature);
+                      for (int band = 0; band < band_count_; ++band) {
+                          uint64_t hash = Mix(band + 1);
+                          for (int row = 0; row < rows_per_band_; ++row) {
+                              hash = Mix(hash ^ signature[band * rows_per_band_ + row]);
+                          }
+                          _band_hashes[position * band_count_ + band] = {hash, index};
+                      }
+    });
+    std::sort(policy, _band_hashes.begin(), _band_hashes.end());
+
+    // Корзина - полоса, совпавшая у нескольких документов. Пары документов корзины не
+    // перечисляются (в большом кластере почти-дубликатов их квадратичное число): документы,
+    // связанные общими корзинами, объединяются в компоненты (union-find), компоненты
+    // независимы и обрабатываются параллельно
+    struct BucketMember {
+        uint32_t root;      // представитель компоненты
+        uint32_t index;     // индекс документа
+        uint32_t bucket;
+    };
+    std::vector<BucketMember> _members;
+    std::vector<uint32_t> parents(_documents.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    auto find_root = [&parents](uint32_t index) {
+        while (parents[index] != index) {
+            parents[index] = parents[parents[index]];
+            index = parents[index];
+        }
+        return index;
+    };
+    uint32_t bucket_count = 0;
+    for (size_t begin = 0, end = 0; begin < _band_hashes.size(); begin = end) {
+        for (end = begin + 1; end < _band_hashes.size() && _band_hashes[end].first == _band_hashes[begin].first; ++end) {}
+        if (end - begin < 2) {
+            continue;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            _members.push_back({0, _band_hashes[i].second, bucket_count});
+            const uint32_t lhs = find_root(_band_hashes[begin].second);
+            const uint32_t rhs = find_root(_band_hashes[i].second);
+            parents[std::max(lhs, rhs)] = std::min(lhs, rhs);
+        }
+        ++bucket_count;
+    }
+    for (BucketMember& member : _members) {
+        member.root = find_root(member.index);
+    }
+    // Компоненты подряд, в компоненте - документы по возрастанию индекса (id) с их корзинами
+    std::sort(policy, _members.begin(), _members.end(),
+              [](const BucketMember& lhs, const BucketMember& rhs) {
+                  return std::tie(lhs.root, lhs.index, lhs.bucket) < std::tie(rhs.root, rhs.index, rhs.bucket);
+              });
+    std::vector<size_t> _component_begins;
+    for (size_t i = 0; i < _members.size(); ++i) {
+        if (i == 0 || _members[i].root != _members[i - 1].root) {
+            _component_begins.push_back(i);
+        }
+    }
+
+    // Документ - дубликат, если похож на оставленный документ с меньшим индексом из общей
+    // корзины. Оставленные документы корзины запоминаются, сравнивается не больше
+    // MAX_KEPT_PER_BUCKET первых из них: в кластере почти-дубликатов оставленных единицы,
+    // а корзина из многих непохожих документов не делает поиск квадратичным
+    static constexpr size_t MAX_KEPT_PER_BUCKET = 32;
+    std::vector<std::vector<uint32_t>> _buckets_kept(bucket_count);
+    std::for_each(policy,
+                  _component_begins.begin(), _component_begins.end(),
+                  [&](const size_t component_begin) {
+                      const uint32_t root = _members[component_begin].root;
+                      for (size_t begin = component_begin, end = begin;
+                           begin < _members.size() && _members[begin].root == root; begin = end) {
+                          const uint32_t index = _members[begin].index;
+                          for (end = begin + 1; end < _members.size() && _members[end].index == index; ++end) {}
+                          const bool is_copy = std::any_of(
+                              _members.begin() + begin, _members.begin() + end, [&](const BucketMember& member) {
+                                  const std::vector<uint32_t>& _kept = _buckets_kept[member.bucket];
+                                  return std::any_of(_kept.begin(), _kept.end(), [&](const uint32_t kept_index) {
+                                      return IsSimilar(_documents[kept_index], _documents[index]);
+                                  });
+                              });
+                          if (is_copy) {
+                              is_duplicate[index] = true;
+                              continue;
+                          }
+                          for (size_t i = begin; i < end; ++i) {
+                              std::vector<uint32_t>& _kept = _buckets_kept[_members[i].bucket];
+                              if (_kept.size() < MAX_KEPT_PER_BUCKET) {
+                                  _kept.push_back(index);
+                              }
+                          }
+                      }
+    });
+}
+
+template <typename ExecutionPolicy>
+void RemoveDuplicates(ExecutionPolicy&& policy, SearchServer& search_server, const DuplicateDetector& detector) {
+    const std::vector<int> _duplicate_ids = detector.FindDuplicates(policy, search_server);
+    for (const int id : _duplicate_ids) {
+        std::cout << "Found duplicate document id "s << id << std::endl;
+    }
+    search_server.RemoveDocuments(policy, _duplicate_ids);
+}
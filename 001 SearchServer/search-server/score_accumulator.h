@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Накопители релевантности для одного потока. Поток обрабатывает свой
+// диапазон id документов, поэтому накопители не требуют синхронизации,
+// а результаты потоков объединяются простым слиянием.
+// Документы с минус-словами отсеиваются до накопителя (DocumentBitmap).
+// Вместе с оценкой хранится внутренний номер документа из posting list,
+// по нему читается рейтинг без поиска по id.
+
+// Плотный массив по всем id диапазона [first_id, last_id] -
+// для запросов, которые затрагивают заметную долю документов диапазона
+class DenseScoreAccumulator
+{
+public:
+    DenseScoreAccumulator(int first_id, int last_id)
+        : first_id_(first_id)
+        , _scores_(static_cast<size_t>(last_id - first_id) + 1, 0.0)
+        , _ordinals_(static_cast<size_t>(last_id - first_id) + 1, NOT_SCORED)
+    {}
+
+    void Add(int document_id, uint32_t ordinal, double score) {
+        const size_t index = static_cast<size_t>(document_id - first_id_);
+        _scores_[index] += score;
+        _ordinals_[index] = ordinal;
+    }
+
+    // function(document_id, ordinal, relevance) в порядке возрастания id
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (size_t index = 0; index < _ordinals_.size(); ++index) {
+            if (_ordinals_[index] != NOT_SCORED) {
+                function(first_id_ + static_cast<int>(index), _ordinals_[index], _scores_[index]);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t NOT_SCORED = UINT32_MAX;
+
+    int first_id_;
+    std::vector<double> _scores_;
+    std::vector<uint32_t> _ordinals_;   // NOT_SCORED - документ не набрал релевантность
+};
+
+// Хеш-таблица с открытой адресацией (линейное пробирование) -
+// для разреженных запросов по большому корпусу
+class HashScoreAccumulator
+{
+public:
+    explicit HashScoreAccumulator(size_t expected_count) {
+        size_t capacity = 16;
+        while (capacity < 2 * expected_count) {
+            capacity *= 2;
+        }
+        _slots_.resize(capacity);
+    }
+
+    void Add(int document_id, uint32_t ordinal, double score) {
+        Slot& slot = FindSlot(document_id);
+        slot.ordinal = ordinal;
+        slot.score += score;
+    }
+
+    // function(document_id, ordinal, relevance) в порядке слотов таблицы
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const Slot& slot : _slots_) {
+            if (slot.document_id != EMPTY) {
+                function(slot.document_id, slot.ordinal, slot.score);
+            }
+        }
+    }
+
+private:
+    static constexpr int EMPTY = -1;
+
+    struct Slot {
+        int document_id = EMPTY;
+        uint32_t ordinal = 0;
+        double score = 0.0;
+    };
+
+    std::vector<Slot> _slots_;
+    size_t size_ = 0;
+
+    Slot& FindSlot(int document_id) {
+        if (2 * (size_ + 1) > _slots_.size()) {
+            Grow();
+        }
+        const size_t mask = _slots_.size() - 1;
+        // Мультипликативное хеширование Фибоначчи
+        size_t index = (static_cast<uint64_t>(static_cast<uint32_t>(document_id)) * 0x9E3779B97F4A7C15ull >> 32) & mask;
+        while (_slots_[index].document_id != EMPTY && _slots_[index].document_id != document_id) {
+            index = (index + 1) & mask;
+        }
+        if (_slots_[index].document_id == EMPTY) {
+            _slots_[index].document_id = document_id;
+            ++size_;
+        }
+        return _slots_[index];
+    }
+
+    void Grow() {
+        std::vector<Slot> old_slots(_slots_.size() * 2);
+        old_slots.swap(_slots_);
+        size_ = 0;
+        for (const Slot& old_slot : old_slots) {
+            if (old_slot.document_id != EMPTY) {
+                FindSlot(old_slot.document_id) = old_slot;
+            }
+        }
+    }
+};
@@ -1,208 +1,724 @@
-#include <algorithm>
-#include <cmath>
-#include <deque>
-
-#include "search_server.h"
-#include "log_duration.h"
-
-using namespace std;
-using DocumentsByStatus = std::tuple<std::vector<std::string_view>, DocumentStatus>;
-
-SearchServer::SearchServer(const std::string_view stopwords_text)
-    : SearchServer(SplitIntoWords(stopwords_text))
-{}
-
-SearchServer::SearchServer(const std::string& stopwords_text)
-    : SearchServer(SplitIntoWords(std::string_view(stopwords_text)))
-{}
-
-void SearchServer::AddDocument(int document_id, const std::string_view document,
-                               DocumentStatus status, const std::vector<int>& ratings) {
-    if (document_id < 0) {
-        throw invalid_argument("Id less then null"s);
-    }
-    if (_id_docdata_.count(document_id)) {
-        throw invalid_argument("This id exist already"s);
-    }
-    std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
-    std::vector<std::string> words_doc;
-    for (const std::string_view word : words) {
-        words_doc.push_back(std::string(word));
-    }
-    _id_docdata_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, words_doc});
-    _id_.insert(document_id);
-    for (const auto& word : _id_docdata_.at(document_id)._words_doc_) {
-            _word_to__id_freq_[word][document_id] += inv_word_count;
-            _id_to__word_freq_[document_id][word] += inv_word_count;
-    }
-}
-
-void SearchServer::RemoveDocument(int document_id) {
-    RemoveDocument(std::execution::seq, document_id);
-}
-
-std::vector<Document>
-SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
-                            raw_query,
-                            [status](int document_id, DocumentStatus document_status, int rating) {
-                                return document_status == status;
-                            });
-}
-
-std::vector<Document>
-SearchServer::FindTopDocuments(std::string_view raw_query) const {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
-}
-
-int SearchServer::GetDocumentCount() const {
-    return _id_docdata_.size();
-}
-
-int SearchServer::GetWordCount(const std::string_view word) const {
-    return _word_to__id_freq_.count(word);
-}
-
-int SearchServer::GetDocRating(const int document_id) const {
-    return _id_docdata_.at(document_id).rating;
-}
-
-std::set<int>::const_iterator SearchServer::begin() const {
-    return _id_.cbegin();
-}
-
-std::set<int>::const_iterator SearchServer::end() const {
-    return _id_.cend();
-}
-
-DocumentsByStatus
-SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
-    return MatchDocument(std::execution::seq, raw_query, document_id);
-}
-
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    return _id_to__word_freq_.at(document_id);
-}
-
-//private
-
-bool SearchServer::IsStopWord(const std::string_view word) const {
-    return _stopwords_.count(word) > 0;
-}
-
-// A valid word must not contain special characters
-bool SearchServer::IsValidWord(const std::string_view word) {
-    return none_of(word.begin(), word.end(),
-        [](char c) { return c >= '\0' && c < ' '; }
-    );
-}
-
-std::vector<std::string_view>
-SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (std::string_view word : SplitIntoWords(text)) {
-        if (!SearchServer::IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + std::string(word) + " is invalid"s);
-        }
-        if (!SearchServer::IsStopWord(word)) {
-            words.push_back(word);
-        }
-    }
-    return words;
-}
-
-int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
-    int rating_sum = 0;
-    rating_sum = std::reduce(std::execution::par, ratings.begin(), ratings.end());
-
-    return rating_sum / static_cast<int>(ratings.size());
-}
-
-SearchServer::QueryWord
-SearchServer::ParseQueryWord(std::string_view text) const {
-
-    bool is_minus = false;
-    if (text[0] == '-') {
-        is_minus = true;
-        text = text.substr(1);
-    }
-    const string& word = std::string(text);
-    if (text.empty() || text[0] == '-' || !SearchServer::IsValidWord(word)) {
-        throw std::invalid_argument("Query word "s + word + " is invalid");
-    }
-
-    return {text, is_minus, SearchServer::IsStopWord(word)};
-}
-
-SearchServer::Query
-SearchServer::ParseQuery(const std::string_view text) const {
-
-    const std::vector<std::string_view> words = SplitIntoWords(text);
-    if (words.empty()) {
-        return {};
-    }
-    SearchServer::Query result;
-
-    for_each(
-             words.begin(), words.end(),
-             [this, &result](std::string_view word) {
-                 const QueryWord query_word = ParseQueryWord(word);
-                 if (!query_word.is_stop) {
-                     (!query_word.is_minus) ? result.plus_words.push_back(query_word.data)
-                                            : result.minus_words.push_back(query_word.data);
-                 }
-             });
-
-    sort(result.minus_words.begin(), result.minus_words.end());
-    const auto it_minus = unique(result.minus_words.begin(), result.minus_words.end());
-    result.minus_words.erase(it_minus, result.minus_words.end());
-
-    sort(result.plus_words.begin(), result.plus_words.end());
-    const auto it_plus = unique(result.plus_words.begin(), result.plus_words.end());
-    result.plus_words.erase(it_plus, result.plus_words.end());
-
-    return result;
-}
-
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(SearchServer::GetDocumentCount() * 1.0 / _word_to__id_freq_.at(std::string(word)).size());
-}
-// ----END OF CLASS-----
-
-
-void AddDocument(SearchServer& search_server, int document_id, const std::string_view document,
-                 DocumentStatus status, const std::vector<int>& ratings)
-{
-    try { search_server.AddDocument(document_id, document, status, ratings); }
-    catch (const std::exception& e) {
-        std::cout << "Error in adding document "s << document_id << ": "s << e.what() << std::endl;
-    }
-}
-
-template <typename ExecutionPolicy>
-void FindTopDocuments(ExecutionPolicy&& policy, const SearchServer& search_server, const std::string_view raw_query) {
-    std::cout << "Results for request: "s << std::string(raw_query) << std::endl;
-    try {
-        for (const Document& document : search_server.FindTopDocuments(policy, raw_query)) {
-            PrintDocument(document);
-        }
-    }
-    catch (const std::exception& e) {
-        std::cout << "Error is seaching: "s << e.what() << std::endl;
-    }
-}
-
-void MatchDocuments(const SearchServer& search_server, const std::string_view query) {
-    try {
-        std::cout << "Matching for request: "s << query << std::endl;
-        for (auto index = search_server.begin(); index != search_server.end(); ++index) {
-            const int document_id = *index;
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
-        }
-    }
-    catch (const std::exception& e) {
-        std::cout << "Error in matchig request "s << query << ": "s << e.what() << std::endl;
-    }
-}
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#include "search_server.h"
+#include "index_file.h"
+#include "log_duration.h"
+
+using namespace std;
+using DocumentsByStatus = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+
+SearchServer::SearchServer(const std::string_view stopwords_text)
+    : SearchServer(SplitIntoWords(stopwords_text))
+{}
+
+SearchServer::SearchServer(const std::string& stopwords_text)
+    : SearchServer(SplitIntoWords(std::string_view(stopwords_text)))
+{}
+
+void SearchServer::AddDocument(int document_id, const std::string_view document,
+                               DocumentStatus status, const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Id less then null"s);
+    }
+    if (_ordinals_.Contains(document_id)) {
+        throw invalid_argument("This id exist already"s);
+    }
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    const double inv_word_count = 1.0 / words.size();
+    // Пары (id слова, позиция слова в документе)
+    std::vector<std::pair<TermId, uint32_t>> term_positions(words.size());
+    for (uint32_t position = 0; position < words.size(); ++position) {
+        term_positions[position] = {_dictionary_.Intern(words[position]), position};
+    }
+    sort(term_positions.begin(), term_positions.end());
+    if (_term_to_postings_.size() < _dictionary_.size()) {
+        _term_to_postings_.resize(_dictionary_.size());
+    }
+
+    // Номер нужен записям posting lists
+    const Ordinal ordinal = _ordinals_.Add(document_id);
+    const DocumentNorms norms{static_cast<double>(words.size()), inv_word_count};
+    DocumentData doc_data{ComputeAverageRating(ratings), status, norms, {}};
+    // Вхождения слова - серия одинаковых id в отсортированном векторе, позиции в ней по возрастанию
+    std::vector<uint32_t> positions;
+    for (auto it = term_positions.begin(); it != term_positions.end();) {
+        const TermId term_id = it->first;
+        positions.clear();
+        for (; it != term_positions.end() && it->first == term_id; ++it) {
+            positions.push_back(it->second);
+        }
+        const uint32_t count = static_cast<uint32_t>(positions.size());
+        _term_to_postings_[term_id].Add(document_id, ordinal, GetStatusTag(status), positions,
+                                        count * inv_word_count);
+        doc_data._term_counts_.emplace_back(term_id, count);
+    }
+    SetDocumentData(ordinal, doc_data);
+}
+
+void SearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(std::execution::seq, document_id);
+}
+
+std::vector<Document>
+SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(raw_query, DocumentAttributeFilter{status}, top_count);
+}
+
+std::vector<Document>
+SearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+void SearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation) {
+    query_evaluation_ = query_evaluation;
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    query_cache_ = QueryCache(capacity);
+}
+
+QueryCache::Stats SearchServer::GetQueryCacheStats() const {
+    return query_cache_.GetStats();
+}
+
+int SearchServer::GetDocumentCount() const {
+    return _ordinals_.size();
+}
+
+int SearchServer::GetWordCount(const std::string_view word) const {
+    return _dictionary_.Find(word) != TermDictionary::NO_TERM;
+}
+
+int SearchServer::GetDocRating(const int document_id) const {
+    return _ordinal_to_rating_[GetOrdinal(document_id)];
+}
+
+DocumentOrdinals::IdIterator SearchServer::begin() const {
+    return _ordinals_.begin();
+}
+
+DocumentOrdinals::IdIterator SearchServer::end() const {
+    return _ordinals_.end();
+}
+
+DocumentsByStatus
+SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    const Ordinal ordinal = GetOrdinal(document_id);
+    if (raw_query.empty()) {
+        throw std::invalid_argument("The query is empty");
+    }
+    const DocumentStatus status = _ordinal_to_status_[ordinal];
+    if (_forward_index_.GetTerms(ordinal).size() == 0) {
+        return {std::vector<std::string_view>{}, status};
+    }
+    const SearchServer::Query query = ParseQuery(raw_query);
+    std::vector<uint32_t> matched_indexes;
+    MatchQueryTerms(query, document_id, ordinal, matched_indexes);
+    std::vector<std::string_view> matched_words(matched_indexes.size());
+    std::transform(matched_indexes.begin(), matched_indexes.end(), matched_words.begin(),
+                   [this, &query](const uint32_t index) { return _dictionary_.GetTerm(query.plus_terms[index]); });
+    // Слова возвращаются в алфавитном порядке, как и раньше
+    std::sort(matched_words.begin(), matched_words.end());
+    return {matched_words, status};
+}
+
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    const TermFrequencies frequencies = GetTermFrequencies(document_id);
+    return {frequencies.begin(), frequencies.end()};
+}
+
+TermFrequencies SearchServer::GetTermFrequencies(int document_id) const {
+    const Ordinal ordinal = GetOrdinal(document_id);
+    return TermFrequencies(_dictionary_, _forward_index_.GetTerms(ordinal), _forward_index_.GetCounts(ordinal),
+                           _ordinal_to_norms_[ordinal].inv_word_count);
+}
+
+void SearchServer::SaveIndex(const std::string& path) const {
+    IndexFileWriter writer(path);
+    IndexFileHeader header{};
+
+    header.stop_words_offset = writer.GetOffset();
+    const std::vector<std::string>& stop_words = _stopwords_.GetWords();
+    writer.WriteStrings(std::vector<std::string_view>(stop_words.begin(), stop_words.end()));
+
+    writer.Align();
+    header.terms_offset = writer.GetOffset();
+    std::vector<std::string_view> terms(_dictionary_.size());
+    for (TermId term_id = 0; term_id < terms.size(); ++term_id) {
+        terms[term_id] = _dictionary_.GetTerm(term_id);
+    }
+    writer.WriteStrings(terms);
+
+    // Posting lists: записи, затем все таблицы блоков подряд (размер блока кратен 8),
+    // затем байты записей, затем байты позиций
+    writer.Align();
+    header.postings_offset = writer.GetOffset();
+    const uint64_t term_count = terms.size();
+    uint64_t blocks_offset = header.postings_offset + sizeof(uint64_t) + term_count * sizeof(IndexPostingRecord);
+    uint64_t data_offset = blocks_offset;
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        data_offset += _term_to_postings_[term_id].GetBlockCount() * sizeof(PostingList::Block);
+    }
+    uint64_t positions_offset = data_offset;
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        positions_offset += _term_to_postings_[term_id].GetDataSize();
+    }
+    writer.WriteValue(term_count);
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        writer.WriteValue(IndexPostingRecord{blocks_offset, postings.GetBlockCount(),
+                                             data_offset, postings.GetDataSize(),
+                                             positions_offset, postings.GetPositionDataSize(),
+                                             postings.size(), postings.MaxTermFreq()});
+        blocks_offset += postings.GetBlockCount() * sizeof(PostingList::Block);
+        data_offset += postings.GetDataSize();
+        positions_offset += postings.GetPositionDataSize();
+    }
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        writer.Write(postings.GetBlocks(), postings.GetBlockCount() * sizeof(PostingList::Block));
+    }
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        writer.Write(postings.GetData(), postings.GetDataSize());
+    }
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        writer.Write(postings.GetPositionData(), postings.GetPositionDataSize());
+    }
+
+    // Документы: записи по возрастанию id, затем id слов документов и числа вхождений
+    writer.Align();
+    header.documents_offset = writer.GetOffset();
+    const std::vector<int> _ids(_ordinals_.begin(), _ordinals_.end());
+    std::vector<Ordinal> ordinals(_ids.size());
+    std::transform(_ids.begin(), _ids.end(), ordinals.begin(),
+                   [this](const int document_id) { return _ordinals_.Find(document_id); });
+    writer.WriteValue<uint64_t>(_ids.size());
+    uint64_t first_term = 0;
+    for (size_t i = 0; i < _ids.size(); ++i) {
+        const Ordinal ordinal = ordinals[i];
+        const auto _terms = _forward_index_.GetTerms(ordinal);
+        writer.WriteValue(IndexDocumentRecord{_ids[i], ordinal, _ordinal_to_rating_[ordinal],
+                                              static_cast<int32_t>(_ordinal_to_status_[ordinal]),
+                                              static_cast<uint32_t>(_terms.size()), 0, first_term,
+                                              _ordinal_to_norms_[ordinal].inv_word_count});
+        first_term += _terms.size();
+    }
+    writer.WriteValue(first_term);
+    // Отрезки документов в прямом индексе идут не по возрастанию id, поэтому пишутся по одному
+    for (const Ordinal ordinal : ordinals) {
+        const auto _terms = _forward_index_.GetTerms(ordinal);
+        if (_terms.size() > 0) {
+            writer.Write(&*_terms.begin(), _terms.size() * sizeof(TermId));
+        }
+    }
+    writer.Align();
+    for (const Ordinal ordinal : ordinals) {
+        const size_t size = _forward_index_.GetTerms(ordinal).size();
+        if (size > 0) {
+            writer.Write(&*_forward_index_.GetCounts(ordinal), size * sizeof(uint32_t));
+        }
+    }
+
+    writer.Finish(header);
+}
+
+SearchServer SearchServer::OpenIndex(const std::string& path, bool verify_checksum) {
+    const auto file = std::make_shared<const MappedFile>(path);
+    const IndexFileHeader& header = file->GetIndexHeader(verify_checksum);
+
+    SearchServer result(file->GetIndexStrings(header.stop_words_offset));
+    const std::vector<std::string_view> terms = file->GetIndexStrings(header.terms_offset);
+    result._dictionary_.AddExternalTerms(file, terms);
+
+    const uint64_t term_count = *file->GetArray<uint64_t>(header.postings_offset, 1);
+    if (term_count != terms.size()) {
+        throw std::runtime_error("Index file is corrupted"s);
+    }
+    const IndexPostingRecord* postings = file->GetArray<IndexPostingRecord>(header.postings_offset + sizeof(uint64_t),
+                                                                             term_count);
+    // Таблицы блоков проверяются и без контрольной суммы: итераторы переходят между блоками
+    // по их смещениям, и несогласованная таблица увела бы чтение за пределы байт списка
+    result._term_to_postings_.reserve(term_count);
+    for (uint64_t i = 0; i < term_count; ++i) {
+        const IndexPostingRecord& record = postings[i];
+        const PostingList::Block* blocks = file->GetArray<PostingList::Block>(record.blocks_offset,
+                                                                              record.block_count);
+        if (!PostingList::IsValidBlockTable(blocks, record.block_count, record.data_size, record.positions_size,
+                                            record.size)) {
+            throw std::runtime_error("Index file is corrupted"s);
+        }
+        result._term_to_postings_.push_back(
+            PostingList::FromExternal(file, blocks, record.block_count,
+                                      file->GetArray<uint8_t>(record.data_offset, record.data_size),
+                                      record.data_size,
+                                      file->GetArray<uint8_t>(record.positions_offset, record.positions_size),
+                                      record.positions_size, record.size, record.max_term_freq));
+    }
+
+    uint64_t offset = header.documents_offset;
+    const uint64_t document_count = *file->GetArray<uint64_t>(offset, 1);
+    offset += sizeof(uint64_t);
+    const IndexDocumentRecord* documents = file->GetArray<IndexDocumentRecord>(offset, document_count);
+    offset += document_count * sizeof(IndexDocumentRecord);
+    const uint64_t total_term_count = *file->GetArray<uint64_t>(offset, 1);
+    offset += sizeof(uint64_t);
+    const TermId* term_ids = file->GetArray<TermId>(offset, total_term_count);
+    offset += (total_term_count * sizeof(TermId) + 7) / 8 * 8;
+    const uint32_t* term_counts = file->GetArray<uint32_t>(offset, total_term_count);
+
+    // Номера документов восстанавливаются прежними: на них ссылаются записи posting lists
+    std::vector<int> _ids(document_count);
+    std::vector<Ordinal> ordinals(document_count);
+    std::vector<uint8_t> is_used;
+    for (uint64_t i = 0; i < document_count; ++i) {
+        const IndexDocumentRecord& record = documents[i];
+        if (record.id < 0 || (i > 0 && record.id <= documents[i - 1].id)
+            || record.ordinal == DocumentOrdinals::NO_ORDINAL) {
+            throw std::runtime_error("Index file is corrupted"s);
+        }
+        if (record.ordinal >= is_used.size()) {
+            is_used.resize(record.ordinal + size_t{1}, 0);
+        }
+        if (is_used[record.ordinal]) {
+            throw std::runtime_error("Index file is corrupted"s);
+        }
+        is_used[record.ordinal] = 1;
+        _ids[i] = record.id;
+        ordinals[i] = record.ordinal;
+    }
+    result._ordinals_.Restore(_ids, ordinals);
+
+    for (uint64_t i = 0; i < document_count; ++i) {
+        const IndexDocumentRecord& record = documents[i];
+        if (record.first_term > total_term_count || record.term_count > total_term_count - record.first_term) {
+            throw std::runtime_error("Index file is corrupted"s);
+        }
+        DocumentData doc_data{record.rating, static_cast<DocumentStatus>(record.status),
+                              {0.0, record.inv_word_count}, {}};
+        doc_data._term_counts_.reserve(record.term_count);
+        for (uint32_t j = 0; j < record.term_count; ++j) {
+            const TermId term_id = term_ids[record.first_term + j];
+            if (term_id >= term_count) {
+                throw std::runtime_error("Index file is corrupted"s);
+            }
+            doc_data._term_counts_.emplace_back(term_id, term_counts[record.first_term + j]);
+            doc_data.norms.word_count += term_counts[record.first_term + j];
+        }
+        result.SetDocumentData(record.ordinal, doc_data);
+    }
+    return result;
+}
+
+//private
+
+bool SearchServer::IsStopWord(const std::string_view word) const {
+    return _stopwords_.Contains(word);
+}
+
+// A valid word must not contain special characters
+bool SearchServer::IsValidWord(const std::string_view word) {
+    return none_of(word.begin(), word.end(),
+        [](char c) { return c >= '\0' && c < ' '; }
+    );
+}
+
+std::vector<std::string_view>
+SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
+    std::vector<std::string_view> words;
+    if (!TokenizeWords(text, words)) {
+        // В тексте есть управляющий символ - ищется слово для сообщения
+        for (const std::string_view word : words) {
+            if (!SearchServer::IsValidWord(word)) {
+                throw std::invalid_argument("Word "s + std::string(word) + " is invalid"s);
+            }
+        }
+    }
+    words.erase(remove_if(words.begin(), words.end(),
+                          [this](const std::string_view word) { return IsStopWord(word); }),
+                words.end());
+    return words;
+}
+
+int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
+    int rating_sum = 0;
+    rating_sum = std::reduce(std::execution::par, ratings.begin(), ratings.end());
+
+    return rating_sum / static_cast<int>(ratings.size());
+}
+
+SearchServer::Ordinal SearchServer::GetOrdinal(int document_id) const {
+    const Ordinal ordinal = _ordinals_.Find(document_id);
+    if (ordinal == DocumentOrdinals::NO_ORDINAL) {
+        throw out_of_range("Id doesn't exist"s);
+    }
+    return ordinal;
+}
+
+void SearchServer::SetDocumentData(Ordinal ordinal, const DocumentData& doc_data) {
+    ResizeDocumentColumns();
+    ++generation_;
+    word_count_ += static_cast<int64_t>(doc_data.norms.word_count);
+    _ordinal_to_rating_[ordinal] = doc_data.rating;
+    _ordinal_to_status_[ordinal] = doc_data.status;
+    _ordinal_to_norms_[ordinal] = doc_data.norms;
+    _forward_index_.Set(ordinal, doc_data._term_counts_);
+}
+
+void SearchServer::ResizeDocumentColumns() {
+    const size_t capacity = _ordinals_.GetCapacity();
+    if (_ordinal_to_rating_.size() < capacity) {
+        _ordinal_to_rating_.resize(capacity);
+        _ordinal_to_status_.resize(capacity);
+        _ordinal_to_norms_.resize(capacity);
+    }
+}
+
+void SearchServer::ReleaseDocumentData(Ordinal ordinal) {
+    ++generation_;
+    word_count_ -= static_cast<int64_t>(_ordinal_to_norms_[ordinal].word_count);
+    _forward_index_.Release(ordinal);
+}
+
+SearchServer::QueryWord
+SearchServer::ParseQueryWord(std::string_view text) const {
+
+    bool is_minus = false;
+    bool is_required = false;
+    if (text[0] == '-') {
+        is_minus = true;
+        text = text.substr(1);
+    } else if (text[0] == '+') {
+        is_required = true;
+        text = text.substr(1);
+    }
+    if ((is_minus || is_required) && !text.empty() && text[0] == '"') {
+        throw std::invalid_argument("Query phrase can't have a minus or plus prefix"s);
+    }
+    // Кавычки вне фразы - незакрытая или лишняя кавычка
+    if (text.empty() || text[0] == '-' || text[0] == '+' || text.find('"') != std::string_view::npos
+        || !SearchServer::IsValidWord(text)) {
+        throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
+    }
+
+    return {text, is_minus, is_required, SearchServer::IsStopWord(text)};
+}
+
+void SearchServer::QueryWords::Clear() {
+    plus_words.clear();
+    minus_words.clear();
+    required_words.clear();
+    phrase_words.clear();
+    phrase_ends.clear();
+}
+
+void SearchServer::Query::Clear() {
+    plus_terms.clear();
+    minus_terms.clear();
+    required_terms.clear();
+    phrase_terms.clear();
+    phrase_ends.clear();
+    is_unsatisfiable = false;
+}
+
+void SearchServer::ParseQueryWords(const std::string_view text, QueryArena& arena) const {
+
+    std::vector<std::string_view>& words = arena._words_;
+    SplitIntoWords(text, words);
+    SearchServer::QueryWords& result = arena.query_words_;
+    result.Clear();
+    if (words.empty()) {
+        return;
+    }
+
+    // Операнды запроса по порядку: слово, фраза или оператор AND
+    std::vector<QueryOperand>& operands = arena._operands_;
+    std::vector<std::string_view>& _operand_words = arena._operand_words_;
+    operands.clear();
+    _operand_words.clear();
+    bool in_phrase = false;
+    for (std::string_view word : words) {
+        if (!in_phrase && word == "AND"sv) {
+            operands.push_back({_operand_words.size(), _operand_words.size(), false, false, true});
+            continue;
+        }
+        if (!in_phrase && word[0] == '"') {
+            in_phrase = true;
+            operands.push_back({_operand_words.size(), _operand_words.size(), false, true, false});
+            word.remove_prefix(1);
+        }
+        if (in_phrase) {
+            if (!word.empty() && word.back() == '"') {
+                in_phrase = false;
+                word.remove_suffix(1);
+            }
+            if (word.find('"') != std::string_view::npos || !IsValidWord(word)) {
+                throw std::invalid_argument("Query word "s + std::string(word) + " is invalid");
+            }
+            if (!word.empty() && !IsStopWord(word)) {
+                _operand_words.push_back(word);
+                ++operands.back().last_word;
+            }
+            continue;
+        }
+        const QueryWord query_word = ParseQueryWord(word);
+        operands.push_back({_operand_words.size(), _operand_words.size(),
+                            query_word.is_minus, query_word.is_required, false});
+        if (!query_word.is_stop) {
+            _operand_words.push_back(query_word.data);
+            ++operands.back().last_word;
+        }
+    }
+    if (in_phrase) {
+        throw std::invalid_argument("Query phrase is not closed"s);
+    }
+    for (size_t i = 0; i < operands.size(); ++i) {
+        if (!operands[i].is_and) {
+            continue;
+        }
+        if (i == 0 || i + 1 == operands.size() || operands[i - 1].is_and || operands[i + 1].is_and) {
+            throw std::invalid_argument("AND must stand between query words"s);
+        }
+        operands[i - 1].is_required = true;
+        operands[i + 1].is_required = true;
+    }
+
+    for (const QueryOperand& operand : operands) {
+        const auto first = _operand_words.begin() + operand.first_word;
+        const auto last = _operand_words.begin() + operand.last_word;
+        if (first == last) {
+            continue;
+        }
+        if (operand.is_minus) {
+            result.minus_words.push_back(*first);
+            continue;
+        }
+        result.plus_words.insert(result.plus_words.end(), first, last);
+        if (last - first > 1) {
+            result.phrase_words.insert(result.phrase_words.end(), first, last);
+            result.phrase_ends.push_back(result.phrase_words.size());
+        } else if (operand.is_required) {
+            result.required_words.push_back(*first);
+        }
+    }
+
+}
+
+SearchServer::QueryWords
+SearchServer::ParseQueryWords(const std::string_view text) const {
+    QueryArena arena;
+    ParseQueryWords(text, arena);
+    return std::move(arena.query_words_);
+}
+
+void SearchServer::MapQueryWords(const QueryWords& query_words, Query& result) const {
+
+    result.Clear();
+    // Повторы убираются уже среди id: сортировка чисел дешевле сортировки строк запроса.
+    // Возвращает, все ли слова нашлись в словаре
+    auto map_words = [this](const std::vector<std::string_view>& words, std::vector<TermId>& term_ids) {
+        bool is_all_found = true;
+        for (const std::string_view word : words) {
+            const TermId term_id = _dictionary_.Find(word);
+            if (term_id != TermDictionary::NO_TERM) {
+                term_ids.push_back(term_id);
+            } else {
+                is_all_found = false;
+            }
+        }
+        sort(term_ids.begin(), term_ids.end());
+        term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+        return is_all_found;
+    };
+    map_words(query_words.plus_words, result.plus_terms);
+    map_words(query_words.minus_words, result.minus_terms);
+    result.is_unsatisfiable = !map_words(query_words.required_words, result.required_terms);
+    for (const std::string_view word : query_words.phrase_words) {
+        result.phrase_terms.push_back(_dictionary_.Find(word));
+        result.is_unsatisfiable |= result.phrase_terms.back() == TermDictionary::NO_TERM;
+    }
+    result.phrase_ends = query_words.phrase_ends;
+}
+
+SearchServer::Query
+SearchServer::MapQueryWords(const QueryWords& query_words) const {
+    SearchServer::Query result;
+    MapQueryWords(query_words, result);
+    return result;
+}
+
+const SearchServer::Query&
+SearchServer::ParseQuery(const std::string_view text, QueryArena& arena) const {
+    ParseQueryWords(text, arena);
+    MapQueryWords(arena.query_words_, arena.query_);
+    return arena.query_;
+}
+
+SearchServer::Query
+SearchServer::ParseQuery(const std::string_view text) const {
+    QueryArena arena;
+    ParseQuery(text, arena);
+    return std::move(arena.query_);
+}
+
+void SearchServer::BuildQueryCacheKey(const Query& query, const DocumentAttributeFilter& filter,
+                                      std::string_view ranking_model, bool is_sequential, size_t top_count,
+                                      std::string& key) {
+    // Значения записываются байтами, векторы - с длиной, поэтому разные запросы не склеиваются в один ключ
+    auto append_value = [&key](const auto& value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto append_vector = [&key, &append_value](const auto& values) {
+        append_value(values.size());
+        key.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0]));
+    };
+    key.clear();
+    append_vector(query.plus_terms);
+    append_vector(query.minus_terms);
+    append_vector(query.required_terms);
+    append_vector(query.phrase_terms);
+    append_vector(query.phrase_ends);
+    append_value(query.is_unsatisfiable);
+    append_value(filter.status.has_value());
+    append_value(filter.status.value_or(DocumentStatus::ACTUAL));
+    append_value(filter.min_rating);
+    append_value(filter.max_rating);
+    append_value(is_sequential);
+    append_value(top_count);
+    key.append(ranking_model);
+}
+
+void SearchServer::MatchQueryTerms(const Query& query, int document_id, Ordinal ordinal,
+                                   std::vector<uint32_t>& matched_indexes) const {
+    matched_indexes.clear();
+    const auto _terms = _forward_index_.GetTerms(ordinal);
+    // Курсор по словам документа только движется вперёд: слова запроса тоже по возрастанию
+    auto contains = [&_terms](ForwardIndex::TermIterator& it, const TermId term_id) {
+        it = lower_bound(it, _terms.end(), term_id);
+        return it != _terms.end() && *it == term_id;
+    };
+    auto it = _terms.begin();
+    for (const TermId term_id : query.minus_terms) {
+        if (contains(it, term_id)) {
+            return;
+        }
+    }
+    if (query.is_unsatisfiable) {
+        return;
+    }
+    it = _terms.begin();
+    for (const TermId term_id : query.required_terms) {
+        if (!contains(it, term_id)) {
+            return;
+        }
+    }
+    for (size_t phrase_index = 0; phrase_index < query.GetPhraseCount(); ++phrase_index) {
+        if (!ContainsPhrase(document_id, query.GetPhrase(phrase_index))) {
+            return;
+        }
+    }
+    it = _terms.begin();
+    for (uint32_t index = 0; index < query.plus_terms.size(); ++index) {
+        if (contains(it, query.plus_terms[index])) {
+            matched_indexes.push_back(index);
+        }
+    }
+}
+
+bool SearchServer::ContainsPhrase(const int document_id,
+                                  const IteratorRange<std::vector<TermId>::const_iterator> phrase) const {
+    std::vector<std::vector<uint32_t>> _word_positions(phrase.size());
+    for (size_t i = 0; i < phrase.size(); ++i) {
+        const PostingList& postings = _term_to_postings_[phrase.begin()[i]];
+        auto it = postings.begin();
+        it.SkipTo(document_id);
+        if (it == postings.end() || it->document_id != document_id) {
+            return false;
+        }
+        it.GetPositions(_word_positions[i]);
+    }
+    return HasConsecutivePositions(_word_positions);
+}
+
+bool SearchServer::HasConsecutivePositions(const std::vector<std::vector<uint32_t>>& _word_positions) {
+    return any_of(_word_positions[0].begin(), _word_positions[0].end(),
+                  [&_word_positions](const uint32_t first_position) {
+                      for (size_t i = 1; i < _word_positions.size(); ++i) {
+                          if (!binary_search(_word_positions[i].begin(), _word_positions[i].end(),
+                                             first_position + i)) {
+                              return false;
+                          }
+                      }
+                      return true;
+                  });
+}
+
+double SearchServer::ComputeInverseDocumentFreq(const int document_count, const size_t word_document_count) {
+    return log(document_count * 1.0 / word_document_count);
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(const TermId term_id) const {
+    return _term_to_postings_[term_id].GetInverseDocumentFreq(SearchServer::GetDocumentCount());
+}
+
+CorpusStatistics SearchServer::GetCorpusStatistics() const {
+    return {GetDocumentCount(), word_count_};
+}
+
+void SearchServer::ComputePlusInverseDocumentFreqs(const Query& query, std::vector<double>& plus_idf) const {
+    plus_idf.assign(query.plus_terms.size(), 0.0);
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        if (!_term_to_postings_[query.plus_terms[i]].empty()) {
+            plus_idf[i] = ComputeWordInverseDocumentFreq(query.plus_terms[i]);
+        }
+    }
+}
+
+std::vector<double> SearchServer::ComputePlusInverseDocumentFreqs(const Query& query) const {
+    std::vector<double> plus_idf;
+    ComputePlusInverseDocumentFreqs(query, plus_idf);
+    return plus_idf;
+}
+// ----END OF CLASS-----
+
+
+void AddDocument(SearchServer& search_server, int document_id, const std::string_view document,
+                 DocumentStatus status, const std::vector<int>& ratings)
+{
+    try { search_server.AddDocument(document_id, document, status, ratings); }
+    catch (const std::exception& e) {
+        std::cout << "Error in adding document "s << document_id << ": "s << e.what() << std::endl;
+    }
+}
+
+template <typename ExecutionPolicy>
+void FindTopDocuments(ExecutionPolicy&& policy, const SearchServer& search_server, const std::string_view raw_query) {
+    std::cout << "Results for request: "s << std::string(raw_query) << std::endl;
+    try {
+        for (const Document& document : search_server.FindTopDocuments(policy, raw_query)) {
+            PrintDocument(document);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "Error is seaching: "s << e.what() << std::endl;
+    }
+}
+
+void MatchDocuments(const SearchServer& search_server, const std::string_view query) {
+    try {
+        std::cout << "Matching for request: "s << query << std::endl;
+        const SearchServer::MatchedDocuments matched = search_server.MatchDocuments(std::execution::par, query,
+                                                                                    search_server);
+        for (size_t i = 0; i < matched.size(); ++i) {
+            const auto words = matched.GetWords(i);
+            PrintMatchDocumentResult(matched.document_ids[i], std::vector<std::string_view>(words.begin(), words.end()),
+                                     matched.statuses[i]);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "Error in matchig request "s << query << ": "s << e.what() << std::endl;
+    }
+}
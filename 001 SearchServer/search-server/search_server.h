@@ -17,8 +17,14 @@
 #include <iostream>
 #include <iterator>
 #include <functional>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <typeinfo>
 #include <mutex>
 #include <future>
+#include <thread>
+#include <unordered_map>
 
 #include "tbb/parallel_for.h"
 #include "tbb/parallel_for_each.h"
@@ -28,16 +34,42 @@
 #include "string_processing.h"
 #include "log_duration.h"
 #include "concurrent_map.h"
+#include "document_bitmap.h"
+#include "document_ordinals.h"
+#include "forward_index.h"
+#include "paginator.h"
+#include "posting_list.h"
+#include "query_cache.h"
+#include "ranking_model.h"
+#include "stop_word_set.h"
+#include "score_accumulator.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
 
 using namespace std::string_literals;
 using DocumentsByStatus = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double MIN_ACCURACY = 1e-6;
-
 class SearchServer
 {
 public:
+    // Способ вычисления FindTopDocuments с последовательной политикой.
+    // WAND (block-max) не вычисляет релевантность документов, которые заведомо
+    // не попадают в выдачу; результат совпадает с полным перебором EXHAUSTIVE.
+    enum class QueryEvaluation {
+        EXHAUSTIVE,
+        WAND,
+    };
+
+    // Запрос - слова через пробел:
+    //   слово      - плюс-слово, документ должен содержать хотя бы одно из плюс-слов;
+    //   -слово     - минус-слово, документы с ним исключаются;
+    //   +слово     - обязательное слово, документ должен его содержать;
+    //   а AND б    - оба операнда AND обязательны;
+    //   "а б в"    - фраза: документ должен содержать слова подряд (стоп-слова не учитываются).
+    // Фраза не может быть минус- или обязательной, кавычки вне фраз и незакрытая фраза -
+    // ошибка, как и другие неверные запросы (invalid_argument).
+    // Релевантность - сумма вкладов всех слов запроса, кроме минус-слов, по модели
+    // ранжирования RankingModel из ranking_model.h (по умолчанию TF-IDF).
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
     explicit SearchServer(std::string_view stopwords_text);
@@ -46,45 +78,108 @@ public:
     void AddDocument(int document_id, std::string_view document,
                      DocumentStatus status, const std::vector<int>& ratings);
 
+    // Добавление пачки документов, результат - как у AddDocument для каждого из них.
+    // Тексты разбираются параллельно в частичные индексы по частям пачки; их posting
+    // lists кодируются один раз и затем дописываются к общим параллельно по словам. При исключении
+    // (недопустимый или повторяющийся id, недопустимое слово) индекс не изменяется.
+    // DocumentContainer - контейнер NewDocument, тексты должны жить до конца вызова
+    template <typename ExecutionPolicy, typename DocumentContainer>
+    void AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents);
+
     template<typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
     void RemoveDocument(int document_id);
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
+    // Удаление пачки документов. Удаляемые id сначала собираются по словам
+    // (отсортированные id документов слова - его метки удаления), затем posting list
+    // каждого затронутого слова уплотняется за один проход, слова - параллельно.
+    // Повторы id допустимы; при отсутствующем id бросается out_of_range и индекс не изменяется
+    template <typename ExecutionPolicy, typename IdContainer>
+    void RemoveDocuments(ExecutionPolicy&& policy, const IdContainer& document_ids);
+
+    // top_count - сколько лучших документов вернуть.
+    // Модель ранжирования задаётся явно: FindTopDocuments<Bm25Ranking>(execution::par, query)
+    template <typename RankingModel = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document>
     FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                     DocumentPredicate document_predicate) const;
+                     DocumentPredicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    template <typename ExecutionPolicy>
+    template <typename RankingModel = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document>
     FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                     DocumentStatus status) const;
+                     DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    template <typename ExecutionPolicy>
+    template <typename RankingModel = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document>
     FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
 
     // Без распараллеливания
-    template <typename DocumentPredicate>
+    template <typename RankingModel = TfIdfRanking, typename DocumentPredicate>
     std::vector<Document>
-    FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document>
-    FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document>
     FindTopDocuments(std::string_view raw_query) const;
 
+    // Память для разбора запросов, принадлежащая вызывающему, см. определение ниже
+    class QueryArena;
+
+    // Как FindTopDocuments без arena, но запрос разбирается в arena: при повторном
+    // использовании одной арены разбор запроса не выделяет память
+    template <typename RankingModel = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document>
+    FindTopDocuments(ExecutionPolicy&& policy, QueryArena& arena, std::string_view raw_query,
+                     DocumentPredicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename RankingModel = TfIdfRanking, typename ExecutionPolicy>
+    std::vector<Document>
+    FindTopDocuments(ExecutionPolicy&& policy, QueryArena& arena, std::string_view raw_query,
+                     DocumentStatus status = DocumentStatus::ACTUAL,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Пакетное выполнение запросов: каждый запрос разбирается один раз, а posting list
+    // каждого слова пакета читается один раз для всех запросов, где слово встречается.
+    // Результат i совпадает с FindTopDocuments(policy, raw_queries[i], document_predicate, top_count).
+    // QueryContainer - контейнер или диапазон строк запросов
+    template <typename RankingModel = TfIdfRanking, typename ExecutionPolicy, typename QueryContainer,
+              typename DocumentPredicate>
+    std::vector<std::vector<Document>>
+    FindTopDocumentsBatch(ExecutionPolicy&& policy, const QueryContainer& raw_queries,
+                          DocumentPredicate document_predicate,
+                          size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+    // Кеш результатов FindTopDocuments на capacity запросов, 0 - без кеша (по умолчанию).
+    // Кешируются запросы с отбором DocumentAttributeFilter и по статусу: произвольный
+    // предикат нельзя сравнить с другим. Ключ - разобранный запрос (одинаковые наборы
+    // слов в любом порядке совпадают), отбор, модель ранжирования, политика и top_count.
+    // Выдача, сохранённая до добавления или удаления документов, не используется.
+    // Запросы с кешем можно выполнять параллельно; сохранённые выдачи и счётчики сбрасываются
+    void SetQueryCacheCapacity(size_t capacity);
+
+    QueryCache::Stats GetQueryCacheStats() const;
+
     int GetDocumentCount() const;
 
     int GetWordCount(const std::string_view word) const;
 
     int GetDocRating(const int document_id) const;
 
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    // Id документов по возрастанию
+    DocumentOrdinals::IdIterator begin() const;
+    DocumentOrdinals::IdIterator end() const;
 
+    // Совпавшие слова запроса по алфавиту и статус документа. Один документ сопоставляется
+    // последовательно при любой политике; для многих документов - MatchDocuments
     template<typename ExecutionPolicy>
     DocumentsByStatus
     MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const;
@@ -92,22 +187,83 @@ public:
     DocumentsByStatus
     MatchDocument(std::string_view raw_query, int document_id) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Результат MatchDocuments в общих буферах: документ i - document_ids[i], statuses[i]
+    // и совпавшие слова GetWords(i) по алфавиту
+    struct MatchedDocuments {
+        std::vector<int> document_ids;
+        std::vector<DocumentStatus> statuses;
+        std::vector<std::string_view> words;
+        std::vector<size_t> word_ends;      // слова документа i - [word_ends[i - 1], word_ends[i]) в words
+
+        size_t size() const {
+            return document_ids.size();
+        }
+
+        IteratorRange<std::vector<std::string_view>::const_iterator> GetWords(size_t index) const {
+            return {words.begin() + (index == 0 ? 0 : word_ends[index - 1]), words.begin() + word_ends[index]};
+        }
+    };
+
+    // Сопоставление запроса с документами document_ids (в заданном порядке): запрос разбирается
+    // один раз, документы делятся на части, которые обрабатываются параллельно.
+    // Результат i совпадает с MatchDocument(raw_query, document_ids[i]) и не зависит от политики.
+    // При отсутствующем id бросается out_of_range до разбора запроса; запрос разбирается,
+    // даже если все документы пусты, поэтому неверный запрос бросает исключение при любых id.
+    // IdContainer - контейнер id, в том числе сам SearchServer
+    template <typename ExecutionPolicy, typename IdContainer>
+    MatchedDocuments
+    MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const IdContainer& document_ids) const;
+
+    // Частоты слов документа по алфавиту
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    // Те же частоты в порядке id словаря - представление прямого индекса,
+    // действительное, пока индекс не изменяется
+    TermFrequencies GetTermFrequencies(int document_id) const;
+
+    // Сохраняет индекс (стоп-слова, словарь, posting lists, документы) в файл формата index_file.h
+    void SaveIndex(const std::string& path) const;
+
+    // Открывает индекс, сохранённый SaveIndex. Словарь и posting lists не копируются:
+    // запросы читают их прямо из отображённого в память файла, страницы которого
+    // разделяются процессами, открывшими тот же файл. Данные документов собираются при открытии.
+    // Без verify_checksum файл не читается целиком - только для доверенных файлов.
+    static SearchServer OpenIndex(const std::string& path, bool verify_checksum = true);
 
 private:
+    // Сегменты ConcurrentSearchServer - экземпляры SearchServer, которые
+    // ранжируются по общей статистике всех сегментов
+    friend class ConcurrentSearchServer;
+    friend class SearchServerSnapshot;
+    friend class DuplicateDetector;
+
+    using TermId = TermDictionary::TermId;
+    using Ordinal = DocumentOrdinals::Ordinal;
 
+    // Данные добавляемого документа
     struct DocumentData {
         int rating;
         DocumentStatus status;
-        std::vector<std::string> _words_doc_;
+        DocumentNorms norms;
+        std::vector<std::pair<TermId, uint32_t>> _term_counts_;    // (id слова, число вхождений) по возрастанию id
     };
 
-    std::set<std::string, std::less<>> _stopwords_;
-    std::map<std::string_view, std::map<int, double>> _word_to__id_freq_;
-    std::map<int, std::map<std::string_view, double>> _id_to__word_freq_;
-    std::map<int, DocumentData> _id_docdata_;
-    std::set<int> _id_;
-    // "_" перед именем и дополнительный между словами - признак контейнера (vector, set, map...)
+    StopWordSet _stopwords_;
+    TermDictionary _dictionary_;
+    std::vector<PostingList> _term_to_postings_;     // индекс - id слова в _dictionary_
+    // Данные документов - столбцы по внутренним номерам документов из _ordinals_:
+    // отбор и ранжирование получают номер по id одним поиском в хеш-таблице.
+    // Posting lists хранят id документов - их порядок задаёт порядок перебора документов
+    DocumentOrdinals _ordinals_;
+    std::vector<int> _ordinal_to_rating_;
+    std::vector<DocumentStatus> _ordinal_to_status_;
+    std::vector<DocumentNorms> _ordinal_to_norms_;
+    ForwardIndex _forward_index_;
+    int64_t word_count_ = 0;    // сумма norms.word_count всех документов
+    uint64_t generation_ = 0;   // поколение индекса, увеличивается при каждом изменении документов
+    mutable QueryCache query_cache_;
+    QueryEvaluation query_evaluation_ = QueryEvaluation::WAND;
+    // "_" перед именем - признак контейнера (vector, set, map...)
     // "_" в конце имени - признак принадлежности к private области класса
 
     bool IsStopWord(std::string_view word) const;
@@ -118,33 +274,235 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    // Номер документа; out_of_range, если документа нет
+    Ordinal GetOrdinal(int document_id) const;
+
+    // Заносит данные документа в столбцы и прямой индекс под номером ordinal
+    void SetDocumentData(Ordinal ordinal, const DocumentData& doc_data);
+
+    // То же для пачки: место в столбцах и прямом индексе занимается сразу для всех документов,
+    // данные заносятся параллельно - номера ordinals различны
+    template <typename ExecutionPolicy>
+    void SetDocumentsData(ExecutionPolicy&& policy, const std::vector<Ordinal>& ordinals,
+                          const std::vector<const DocumentData*>& documents);
+
+    // Столбцы данных документов - на все номера меньше _ordinals_.GetCapacity()
+    void ResizeDocumentColumns();
+
+    // Освобождает данные документа перед освобождением его номера
+    void ReleaseDocumentData(Ordinal ordinal);
+
+    // Метка записей posting lists документа со статусом status (PostingList::Block::tag_mask)
+    static uint32_t GetStatusTag(DocumentStatus status) {
+        return uint32_t{1} << static_cast<uint32_t>(status);
+    }
+
+    // Метки статусов, которые может принять предикат: блоки posting lists без них
+    // пропускаются целиком. Произвольный предикат принимает любые статусы
+    template <typename DocumentPredicate>
+    static uint32_t GetAcceptedStatusTags(const DocumentPredicate&) {
+        return ~uint32_t{0};
+    }
+    static uint32_t GetAcceptedStatusTags(const DocumentAttributeFilter& filter) {
+        return filter.status ? GetStatusTag(*filter.status) : ~uint32_t{0};
+    }
+
+    // Метки статусов, с которыми предикат принимает документ при любых id и рейтинге:
+    // для блока posting list, все метки которого среди них, предикат не вызывается
+    template <typename DocumentPredicate>
+    static uint32_t GetAlwaysAcceptedStatusTags(const DocumentPredicate&) {
+        return 0;
+    }
+    static uint32_t GetAlwaysAcceptedStatusTags(const DocumentAttributeFilter& filter) {
+        return filter.min_rating == std::numeric_limits<int>::min()
+                && filter.max_rating == std::numeric_limits<int>::max()
+            ? GetAcceptedStatusTags(filter) : 0;
+    }
+
+    // Нормы документа с номером ordinal, если он проходит document_predicate, иначе nullptr.
+    // Номер берётся из записи posting list, поэтому столбцы читаются без поиска по id;
+    // block_tag_mask - маска блока с этой записью
+    template <typename DocumentPredicate>
+    const DocumentNorms* FindAcceptedDocument(DocumentPredicate& document_predicate, int document_id,
+                                              Ordinal ordinal, uint32_t block_tag_mask) const;
+
     struct QueryWord
     {
         std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
-    struct Query {
+    // Слова запроса без стоп-слов в порядке запроса, возможно с повторами (их убирает MapQueryWords).
+    // Обязательные слова и слова фраз входят и в plus_words.
+    struct QueryWords {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<std::string_view> required_words;
+        // Фразы подряд, каждая - слова по порядку, не менее двух;
+        // фраза i - [phrase_ends[i - 1], phrase_ends[i]) в phrase_words
+        std::vector<std::string_view> phrase_words;
+        std::vector<size_t> phrase_ends;
+
+        // Векторы очищаются с сохранением памяти
+        void Clear();
+    };
+
+    // Операнд запроса: слово, фраза или оператор AND
+    struct QueryOperand {
+        size_t first_word;          // слова операнда без стоп-слов - [first_word, last_word) в списке слов
+        size_t last_word;
+        bool is_minus;
+        bool is_required;
+        bool is_and;
     };
 
+    void ParseQueryWords(std::string_view text, QueryArena& arena) const;
+
+    QueryWords ParseQueryWords(std::string_view text) const;
+
+    // Слова запроса, отсутствующие в словаре, ни с одним документом не совпадают и отбрасываются;
+    // если отсутствует обязательное слово или слово фразы, запросу не соответствует ни один документ
+    struct Query {
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        std::vector<TermId> required_terms;
+        std::vector<TermId> phrase_terms;   // как QueryWords::phrase_words
+        std::vector<size_t> phrase_ends;
+        bool is_unsatisfiable = false;
+
+        // Документ должен содержать обязательные слова и фразы
+        bool IsConjunctive() const {
+            return !required_terms.empty() || !phrase_ends.empty();
+        }
+
+        size_t GetPhraseCount() const {
+            return phrase_ends.size();
+        }
+
+        IteratorRange<std::vector<TermId>::const_iterator> GetPhrase(size_t phrase_index) const {
+            return {phrase_terms.begin() + (phrase_index == 0 ? 0 : phrase_ends[phrase_index - 1]),
+                    phrase_terms.begin() + phrase_ends[phrase_index]};
+        }
+
+        void Clear();
+    };
+
+    void MapQueryWords(const QueryWords& query_words, Query& result) const;
+
+    Query MapQueryWords(const QueryWords& query_words) const;
+
+    // Запрос разбирается в arena, результат - ссылка на её содержимое
+    const Query& ParseQuery(std::string_view text, QueryArena& arena) const;
+
     Query ParseQuery(std::string_view text) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Ключ кеша результатов: слова запроса, отбор, модель ранжирования, политика и top_count
+    static void BuildQueryCacheKey(const Query& query, const DocumentAttributeFilter& filter,
+                                   std::string_view ranking_model, bool is_sequential, size_t top_count,
+                                   std::string& key);
+
+    // IDF слова, которое встречается в word_document_count > 0 документах из document_count
+    static double ComputeInverseDocumentFreq(int document_count, size_t word_document_count);
+
+    // Posting list must be non-empty
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
+
+    CorpusStatistics GetCorpusStatistics() const;
+
+    // IDF плюс-слов запроса в порядке query.plus_terms (0 для слов без документов)
+    void ComputePlusInverseDocumentFreqs(const Query& query, std::vector<double>& plus_idf) const;
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<double> ComputePlusInverseDocumentFreqs(const Query& query) const;
+
+    // Ранжирование разобранного запроса с заданными IDF плюс-слов
+    template <typename RankingModel, typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document>
-    FindAllDocuments(ExecutionPolicy&& policy, const Query& query,
-                     DocumentPredicate document_predicate) const;
+    RankDocuments(ExecutionPolicy&& policy, const Query& query, const std::vector<double>& plus_idf,
+                  const RankingModel& ranking_model, DocumentPredicate document_predicate, size_t top_count) const;
 
-    template <typename ExecutionPolicy>
+    template <typename RankingModel, typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document>
-    FindAllDocuments(ExecutionPolicy&& policy, const Query& query) const;
+    FindAllDocuments(ExecutionPolicy&& policy, const Query& query, const std::vector<double>& plus_idf,
+                     const RankingModel& ranking_model, DocumentPredicate document_predicate) const;
+
+    // Posting list плюс-слова вместе с IDF слова
+    using WeightedPostings = std::pair<const PostingList*, double>;
+
+    // Релевантность документов с id из [first_id, last_id] - часть работы FindAllDocuments;
+    // документы из excluded_documents (с минус-словами) пропускаются
+    template <typename RankingModel, typename Accumulator, typename DocumentPredicate>
+    void ScoreDocumentRange(const std::vector<WeightedPostings>& plus_postings,
+                            const DocumentBitmap& excluded_documents, const RankingModel& ranking_model,
+                            int first_id, int last_id, DocumentPredicate& document_predicate,
+                            Accumulator& accumulator, std::vector<Document>& matched_documents) const;
+
+    template <typename RankingModel, typename DocumentPredicate>
+    std::vector<Document>
+    FindTopDocumentsWand(const Query& query, const std::vector<double>& plus_idf, const RankingModel& ranking_model,
+                         DocumentPredicate document_predicate, size_t top_count) const;
+
+    // Запрос с обязательными словами и фразами: перебираются только документы
+    // из пересечения posting lists обязательных слов и слов фраз
+    template <typename RankingModel, typename DocumentPredicate>
+    std::vector<Document>
+    FindTopDocumentsConjunctive(const Query& query, const std::vector<double>& plus_idf,
+                                const RankingModel& ranking_model,
+                                DocumentPredicate document_predicate, size_t top_count) const;
+
+    // Индексы в query.plus_terms (по возрастанию) плюс-слов, которые содержит документ;
+    // пусто, если документ содержит минус-слово или не содержит обязательного слова или фразы.
+    // Слова запроса и документа отсортированы по id и сравниваются слиянием
+    void MatchQueryTerms(const Query& query, int document_id, Ordinal ordinal,
+                         std::vector<uint32_t>& matched_indexes) const;
+
+    // Содержит ли документ слова phrase подряд
+    bool ContainsPhrase(int document_id, IteratorRange<std::vector<TermId>::const_iterator> phrase) const;
+
+    // Есть ли p, при котором p + i входит в _word_positions[i] для каждого i (позиции по возрастанию)
+    static bool HasConsecutivePositions(const std::vector<std::vector<uint32_t>>& _word_positions);
+
+    // Слово пакета запросов и запросы, в которых оно встречается
+    struct BatchTerm {
+        TermId term_id;
+        double inverse_document_freq;
+        std::vector<uint32_t> plus_queries;
+        std::vector<uint32_t> minus_queries;
+    };
+
+    // Часть работы FindTopDocumentsBatch: документы с id из [first_id, last_id]
+    template <typename RankingModel, typename DocumentPredicate>
+    void ScoreBatchRange(const std::vector<BatchTerm>& batch_terms, size_t query_count,
+                         const RankingModel& ranking_model,
+                         int first_id, int last_id, DocumentPredicate& document_predicate,
+                         std::vector<TopDocuments>& tops) const;
+
+    // Переносит в индекс документы other, для которых keep_document(id) истинно.
+    // Id переносимых документов не должны присутствовать в индексе.
+    template <typename DocumentFilter>
+    void MergeFrom(const SearchServer& other, DocumentFilter keep_document);
+};
+
+// Память для разбора запросов, принадлежащая вызывающему: слова запроса,
+// его операнды и результат разбора. Векторы арены очищаются между запросами
+// без освобождения памяти, поэтому после нескольких запросов разбор через ту же
+// арену не выделяет память. Арена используется одним потоком за раз и может
+// переходить между экземплярами SearchServer.
+class SearchServer::QueryArena
+{
+private:
+    friend class SearchServer;
+
+    std::vector<std::string_view> _words_;
+    std::vector<QueryOperand> _operands_;
+    std::vector<std::string_view> _operand_words_;
+    QueryWords query_words_;
+    Query query_;
+    std::vector<double> _plus_idf_;
+    std::string cache_key_;
 };
 
 template <typename StringContainer>
@@ -156,225 +514,1156 @@ SearchServer::SearchServer(const StringContainer& stop_words)
         throw std::invalid_argument("Found a special symbol(s)"s);
     }
 
-    for (const std::string_view word : stop_words) {       // Extract non-empty stop words
-        if (!word.empty()) {
-            _stopwords_.insert(std::string(word));
-        }
-    }
+    _stopwords_ = StopWordSet(std::vector<std::string_view>(stop_words.begin(), stop_words.end()));
 }
 
 template<typename ExecutionPolicy>
 DocumentsByStatus
-SearchServer::MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const {
+SearchServer::MatchDocument(ExecutionPolicy&&, std::string_view raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
+}
+
+template <typename ExecutionPolicy, typename IdContainer>
+SearchServer::MatchedDocuments
+SearchServer::MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                             const IdContainer& document_ids) const {
 
-    if (_id_.count(document_id) == 0) {
-        throw std::out_of_range("Id doesn't exist");
+    MatchedDocuments result;
+    result.document_ids.assign(std::begin(document_ids), std::end(document_ids));
+    const size_t document_count = result.document_ids.size();
+    std::vector<Ordinal> ordinals(document_count);
+    std::transform(result.document_ids.begin(), result.document_ids.end(), ordinals.begin(),
+                   [this](const int document_id) { return GetOrdinal(document_id); });
+    if (document_count == 0) {
+        return result;
     }
     if (raw_query.empty()) {
         throw std::invalid_argument("The query is empty");
     }
-    const std::map<std::string_view, double>* _word_freq = &GetWordFrequencies(document_id);
-    if (_word_freq->empty()) {
-        return {{}, _id_docdata_.at(document_id).status};
-    }
-    SearchServer::Query&& query = ParseQuery(raw_query);
+    const SearchServer::Query query = ParseQuery(raw_query);
 
-    auto comparator = [&_word_freq](const std::string_view word) {
-                          return _word_freq->count(word) > 0;
-                      };
-    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), comparator)) {
-        return {{}, _id_docdata_.at(document_id).status};
+    // Плюс-слова запроса по алфавиту: совпавшие слова документа упорядочиваются сортировкой их рангов
+    const size_t plus_count = query.plus_terms.size();
+    std::vector<std::string_view> _ranked_words(plus_count);
+    std::vector<uint32_t> _word_ranks(plus_count);
+    {
+        std::vector<uint32_t> _by_word(plus_count);
+        std::iota(_by_word.begin(), _by_word.end(), 0);
+        std::sort(_by_word.begin(), _by_word.end(),
+                  [this, &query](const uint32_t lhs, const uint32_t rhs) {
+                      return _dictionary_.GetTerm(query.plus_terms[lhs]) < _dictionary_.GetTerm(query.plus_terms[rhs]);
+                  });
+        for (uint32_t rank = 0; rank < plus_count; ++rank) {
+            _ranked_words[rank] = _dictionary_.GetTerm(query.plus_terms[_by_word[rank]]);
+            _word_ranks[_by_word[rank]] = rank;
+        }
     }
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    std::atomic_uint index = 0;
-    const auto it_end = _word_freq->end();
 
+    // Части - отрезки document_ids; слова каждой части пишутся в её буфер,
+    // буферы объединяются по порядку частей, поэтому результат не зависит от потоков
+    static constexpr size_t MIN_PART_DOCUMENTS = 1024;
+    size_t part_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        part_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                          document_count / MIN_PART_DOCUMENTS));
+    }
+    result.statuses.resize(document_count);
+    result.word_ends.resize(document_count);
+    std::vector<std::vector<std::string_view>> _parts_words(part_count);
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
     std::for_each(policy,
-                  query.plus_words.begin(), query.plus_words.end(),
-                  [&_word_freq, &matched_words, &index, &it_end](const std::string_view word) {
-                      if (_word_freq->find(word) != it_end) {
-                          matched_words[index++] = word;
+                  parts.begin(), parts.end(),
+                  [&](const size_t part) {
+                      std::vector<uint32_t> matched_indexes;
+                      std::vector<std::string_view>& _words = _parts_words[part];
+                      for (size_t i = document_count * part / part_count;
+                           i < document_count * (part + 1) / part_count; ++i) {
+                          result.statuses[i] = _ordinal_to_status_[ordinals[i]];
+                          MatchQueryTerms(query, result.document_ids[i], ordinals[i], matched_indexes);
+                          for (uint32_t& index : matched_indexes) {
+                              index = _word_ranks[index];
+                          }
+                          std::sort(matched_indexes.begin(), matched_indexes.end());
+                          for (const uint32_t rank : matched_indexes) {
+                              _words.push_back(_ranked_words[rank]);
+                          }
+                          result.word_ends[i] = matched_indexes.size();
                       }
     });
 
-    matched_words.resize(index);
-    return {matched_words, _id_docdata_.at(document_id).status};
+    std::partial_sum(result.word_ends.begin(), result.word_ends.end(), result.word_ends.begin());
+    result.words.reserve(result.word_ends.back());
+    for (const auto& _words : _parts_words) {
+        result.words.insert(result.words.end(), _words.begin(), _words.end());
+    }
+    return result;
 }
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
+template <typename RankingModel, typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document>
 SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                               DocumentPredicate document_predicate) const {
+                               DocumentPredicate document_predicate, size_t top_count) const {
+    QueryArena arena;
+    return FindTopDocuments<RankingModel>(policy, arena, raw_query, document_predicate, top_count);
+}
 
-    const SearchServer::Query query = ParseQuery(raw_query);
-    std::vector<Document> matched_documents = FindAllDocuments(policy, query, document_predicate);
-    sort(policy,
-         matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             return lhs.relevance > rhs.relevance
-                 || (std::abs(lhs.relevance - rhs.relevance) < MIN_ACCURACY && lhs.rating > rhs.rating);
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename RankingModel, typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document>
+SearchServer::FindTopDocuments(ExecutionPolicy&& policy, QueryArena& arena, std::string_view raw_query,
+                               DocumentPredicate document_predicate, size_t top_count) const {
+
+    const SearchServer::Query& query = ParseQuery(raw_query, arena);
+    constexpr bool is_cacheable = std::is_same_v<std::decay_t<DocumentPredicate>, DocumentAttributeFilter>;
+    if constexpr (is_cacheable) {
+        if (query_cache_.IsEnabled()) {
+            BuildQueryCacheKey(query, document_predicate, typeid(RankingModel).name(),
+                               std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>,
+                               top_count, arena.cache_key_);
+            std::optional<std::vector<Document>> cached_documents = query_cache_.Find(arena.cache_key_, generation_);
+            if (cached_documents) {
+                return std::move(*cached_documents);
+            }
+        }
     }
-    return matched_documents;
+    ComputePlusInverseDocumentFreqs(query, arena._plus_idf_);
+    std::vector<Document> result = RankDocuments(policy, query, arena._plus_idf_,
+                                                 RankingModel(GetCorpusStatistics()), document_predicate, top_count);
+    if constexpr (is_cacheable) {
+        if (query_cache_.IsEnabled()) {
+            query_cache_.Insert(arena.cache_key_, generation_, result);
+        }
+    }
+    return result;
 }
 
-template <typename ExecutionPolicy>
+template <typename RankingModel, typename ExecutionPolicy>
+std::vector<Document>
+SearchServer::FindTopDocuments(ExecutionPolicy&& policy, QueryArena& arena, std::string_view raw_query,
+                               DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments<RankingModel>(policy, arena, raw_query, DocumentAttributeFilter{status}, top_count);
+}
+
+template <typename RankingModel, typename ExecutionPolicy>
 std::vector<Document>
 SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                               DocumentStatus status) const {
-    return FindTopDocuments(policy,
-                            raw_query,
-                            [status](int document_id, DocumentStatus document_status, int rating) {
-                                return document_status == status;
-                            });
+                               DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments<RankingModel>(policy, raw_query, DocumentAttributeFilter{status}, top_count);
 }
 
-template <typename ExecutionPolicy>
+template <typename RankingModel, typename ExecutionPolicy>
 std::vector<Document>
 SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
-    const SearchServer::Query query = ParseQuery(raw_query);
-    std::vector<Document> matched_documents = FindAllDocuments(policy, query);
-    sort(policy,
-         matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             return lhs.relevance > rhs.relevance
-                 || (std::abs(lhs.relevance - rhs.relevance) < MIN_ACCURACY && lhs.rating > rhs.rating);
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    return FindTopDocuments<RankingModel>(policy, raw_query, DocumentAttributeFilter{});
 }
 
 // Без распараллеливания
+template <typename RankingModel, typename DocumentPredicate>
+std::vector<Document>
+SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                               size_t top_count) const {
+    return FindTopDocuments<RankingModel>(std::execution::seq, raw_query, document_predicate, top_count);
+}
+
 template <typename DocumentPredicate>
+const DocumentNorms* SearchServer::FindAcceptedDocument(DocumentPredicate& document_predicate,
+                                                        int document_id, Ordinal ordinal,
+                                                        uint32_t block_tag_mask) const {
+    if ((block_tag_mask & ~GetAlwaysAcceptedStatusTags(document_predicate)) == 0) {
+        return &_ordinal_to_norms_[ordinal];
+    }
+    return document_predicate(document_id, _ordinal_to_status_[ordinal], _ordinal_to_rating_[ordinal])
+           ? &_ordinal_to_norms_[ordinal] : nullptr;
+}
+
+template <typename RankingModel, typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document>
-SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+SearchServer::RankDocuments(ExecutionPolicy&& policy, const Query& query, const std::vector<double>& plus_idf,
+                            const RankingModel& ranking_model,
+                            DocumentPredicate document_predicate, size_t top_count) const {
+
+    if (query.is_unsatisfiable) {
+        return {};
+    }
+    // Пересечение обычно мало, поэтому выполняется последовательно при любой политике
+    if (query.IsConjunctive()) {
+        return FindTopDocumentsConjunctive(query, plus_idf, ranking_model, document_predicate, top_count);
+    }
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        if (query_evaluation_ == QueryEvaluation::WAND) {
+            return FindTopDocumentsWand(query, plus_idf, ranking_model, document_predicate, top_count);
+        }
+    }
+    const std::vector<Document> matched_documents = FindAllDocuments(policy, query, plus_idf, ranking_model,
+                                                                      document_predicate);
+    return SelectTopDocuments(policy, matched_documents, top_count);
 }
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
+template <typename RankingModel, typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document>
-SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query,
+SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query, const std::vector<double>& plus_idf,
+                               const RankingModel& ranking_model,
                                DocumentPredicate document_predicate) const {
 
-    ConcurrentMap<int, double> document_to_relevance(10007); //10007 - подобранное эффективное значение
-    const auto it_end = _word_to__id_freq_.end();
+    if (_ordinals_.empty()) {
+        return {};
+    }
+    std::vector<WeightedPostings> plus_postings;
+    size_t posting_count = 0;
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const PostingList& postings = _term_to_postings_[query.plus_terms[i]];
+        if (!postings.empty()) {
+            plus_postings.push_back({&postings, plus_idf[i]});
+            posting_count += postings.size();
+        }
+    }
+
+    // Документы с минус-словами отбираются до подсчёта релевантности,
+    // чтобы не тратить на них работу по плюс-словам
+    DocumentBitmap excluded_documents;
+    for (const TermId term_id : query.minus_terms) {
+        for (const PostingList::Posting& posting : _term_to_postings_[term_id]) {
+            excluded_documents.Add(posting.document_id);
+        }
+    }
+
+    // Диапазон id документов делится между потоками, каждый считает релевантность
+    // в собственном накопителе, поэтому блокировки не нужны
+    static constexpr size_t MIN_PART_POSTINGS = 16384;
+    static constexpr size_t DENSE_SLOTS_PER_POSTING = 4;
+    size_t part_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        part_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                          posting_count / MIN_PART_POSTINGS));
+    }
+    const int64_t first_id = _ordinals_.GetFirstId();
+    const int64_t id_span = int64_t{_ordinals_.GetLastId()} - first_id + 1;
+    const size_t expected_count = posting_count / part_count + 1;
+
+    std::vector<std::vector<Document>> _parts_documents(part_count);
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
     for_each(policy,
-             query.plus_words.begin(), query.plus_words.end(),
-             [this, &document_predicate, &document_to_relevance, &it_end](const auto word) {
-                 if (_word_to__id_freq_.find(word) != it_end) {
-                     //Заполнение ConcurrentMap данными по плюс-словам
-                     const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                     for(const auto& id_freq : _word_to__id_freq_.at(word)) {
-                         const int document_id = id_freq.first;
-                         const double term_freq = id_freq.second;
-                         const auto& doc_data = _id_docdata_.at(document_id);
-                         if (document_predicate(document_id, doc_data.status, doc_data.rating)) {
-                             document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                         }
-                     }
+             parts.begin(), parts.end(),
+             [&](const size_t part) {
+                 const int part_first_id = static_cast<int>(first_id + id_span * part / part_count);
+                 const int part_last_id = static_cast<int>(first_id + id_span * (part + 1) / part_count - 1);
+                 if (part_last_id < part_first_id) {
+                     return;
+                 }
+                 const size_t part_width = static_cast<size_t>(int64_t{part_last_id} - part_first_id) + 1;
+                 // Плотный массив выгоден, если документов на слот приходится достаточно,
+                 // иначе (большой разреженный корпус) - хеш-таблица
+                 if (part_width <= DENSE_SLOTS_PER_POSTING * expected_count) {
+                     DenseScoreAccumulator accumulator(part_first_id, part_last_id);
+                     ScoreDocumentRange(plus_postings, excluded_documents, ranking_model, part_first_id, part_last_id,
+                                        document_predicate, accumulator, _parts_documents[part]);
+                 } else {
+                     HashScoreAccumulator accumulator(expected_count);
+                     ScoreDocumentRange(plus_postings, excluded_documents, ranking_model, part_first_id, part_last_id,
+                                        document_predicate, accumulator, _parts_documents[part]);
                  }
     });
-    // Удаление данных по минус-словам
-    for_each(policy,
-             query.minus_words.begin(), query.minus_words.end(),
-             [this, &document_to_relevance, &it_end](const auto word) {
-                 if (_word_to__id_freq_.find(word) != it_end) {
-                     for (const auto& [document_id, freq] : _word_to__id_freq_.at(word)) {
-                         document_to_relevance.Erase(document_id);
-                     }
-
-                  }
+
+    if (part_count == 1) {
+        return std::move(_parts_documents[0]);
+    }
+    std::vector<Document> matched_documents;
+    for (const auto& _part_documents : _parts_documents) {
+        matched_documents.insert(matched_documents.end(), _part_documents.begin(), _part_documents.end());
+    }
+    return matched_documents;
+}
+
+template <typename RankingModel, typename Accumulator, typename DocumentPredicate>
+void SearchServer::ScoreDocumentRange(const std::vector<WeightedPostings>& plus_postings,
+                                      const DocumentBitmap& excluded_documents, const RankingModel& ranking_model,
+                                      int first_id, int last_id, DocumentPredicate& document_predicate,
+                                      Accumulator& accumulator, std::vector<Document>& matched_documents) const {
+
+    const uint32_t accepted_tags = GetAcceptedStatusTags(document_predicate);
+    const uint32_t always_accepted_tags = GetAlwaysAcceptedStatusTags(document_predicate);
+    for (const auto& [postings, inverse_document_freq] : plus_postings) {
+        auto it = postings->begin();
+        const auto it_end = postings->end();
+        it.SkipTo(first_id);
+        while (it != it_end && it->document_id <= last_id) {
+            const uint32_t block_tag_mask = it.GetBlockTagMask();
+            if ((block_tag_mask & accepted_tags) == 0) {
+                // В блоке нет документов принимаемых статусов
+                it.NextBlock();
+                continue;
+            }
+            if ((block_tag_mask & ~always_accepted_tags) == 0) {
+                // Все документы блока проходят предикат: до конца блока он не вызывается
+                const int block_last_id = std::min(last_id, it.GetBlockLastId());
+                for (; it != it_end && it->document_id <= block_last_id; ++it) {
+                    if (!excluded_documents.Contains(it->document_id)) {
+                        accumulator.Add(it->document_id, it->ordinal,
+                                        ranking_model.Score(inverse_document_freq, it->count,
+                                                            _ordinal_to_norms_[it->ordinal]));
+                    }
+                }
+                continue;
+            }
+            if (!excluded_documents.Contains(it->document_id)) {
+                if (const DocumentNorms* norms = FindAcceptedDocument(document_predicate, it->document_id,
+                                                                      it->ordinal, block_tag_mask)) {
+                    accumulator.Add(it->document_id, it->ordinal,
+                                    ranking_model.Score(inverse_document_freq, it->count, *norms));
+                }
+            }
+            ++it;
+        }
+    }
+    accumulator.ForEach([this, &matched_documents](const int document_id, const Ordinal ordinal,
+                                                   const double relevance) {
+        matched_documents.push_back({document_id, relevance, _ordinal_to_rating_[ordinal]});
     });
-    // Заполнение отмеченными документами (с использованием поля bucket_ класса ConcurrentMap)
-    std::vector<Document> matched_documents(document_to_relevance.bucket_.size());
-    std::atomic_uint index = 0;
-    for (auto&& [mutex, map] : document_to_relevance.bucket_) {
-        //std::lock_guard guard(mutex);
-        if (map.empty()) {
+}
+
+template <typename RankingModel, typename DocumentPredicate>
+std::vector<Document>
+SearchServer::FindTopDocumentsWand(const Query& query, const std::vector<double>& plus_idf,
+                                   const RankingModel& ranking_model,
+                                   DocumentPredicate document_predicate, size_t top_count) const {
+
+    struct Cursor {
+        PostingList::Iterator it;
+        PostingList::Iterator end;
+        double inverse_document_freq;
+        double upper_bound;     // максимальный вклад слова в релевантность
+    };
+    if (top_count == 0) {
+        return {};
+    }
+    // Курсоры в порядке id слов: в этом же порядке релевантность суммирует полный перебор
+    std::vector<Cursor> cursors;
+    cursors.reserve(query.plus_terms.size());
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const PostingList& postings = _term_to_postings_[query.plus_terms[i]];
+        if (!postings.empty()) {
+            const double inverse_document_freq = plus_idf[i];
+            cursors.push_back({postings.begin(), postings.end(), inverse_document_freq,
+                               ranking_model.UpperBound(inverse_document_freq, postings.MaxTermFreq())});
+        }
+    }
+    std::vector<Cursor> minus_cursors;
+    for (const TermId term_id : query.minus_terms) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        minus_cursors.push_back({postings.begin(), postings.end(), 0.0, 0.0});
+    }
+    // Документы проверяются по возрастанию id, поэтому курсоры минус-слов только движутся вперёд
+    auto is_excluded = [&minus_cursors](const int document_id) {
+        return std::any_of(minus_cursors.begin(), minus_cursors.end(),
+                           [document_id](Cursor& cursor) {
+                               cursor.it.SkipTo(document_id);
+                               return cursor.it != cursor.end && cursor.it->document_id == document_id;
+                           });
+    };
+    auto skip_to = [](Cursor& cursor, const int64_t document_id) {
+        if (document_id > std::numeric_limits<int>::max()) {
+            cursor.it = cursor.end;
+        } else {
+            cursor.it.SkipTo(static_cast<int>(document_id));
+        }
+    };
+
+    const uint32_t accepted_tags = GetAcceptedStatusTags(document_predicate);
+    TopDocuments top(top_count);
+    std::vector<Cursor*> ordered(cursors.size());
+    std::transform(cursors.begin(), cursors.end(), ordered.begin(), [](Cursor& cursor) { return &cursor; });
+    while (true) {
+        ordered.erase(std::remove_if(ordered.begin(), ordered.end(),
+                                     [](const Cursor* cursor) { return cursor->it == cursor->end; }),
+                      ordered.end());
+        if (ordered.empty()) {
+            break;
+        }
+        // Сдвинутые курсоры находятся в начале, остальные уже упорядочены - сортировка вставками
+        for (size_t i = 1; i < ordered.size(); ++i) {
+            Cursor* cursor = ordered[i];
+            size_t j = i;
+            for (; j > 0 && ordered[j - 1]->it->document_id > cursor->it->document_id; --j) {
+                ordered[j] = ordered[j - 1];
+            }
+            ordered[j] = cursor;
+        }
+
+        // Документ попадает в выдачу, только если его релевантность больше threshold.
+        // Первый MIN_ACCURACY - из IsMoreRelevant: документ с большим рейтингом вытесняет
+        // худший, уступая ему в релевантности меньше MIN_ACCURACY (меньший id при равных
+        // релевантности и рейтинге выиграть не может - документы перебираются по возрастанию id).
+        // Второй - запас на округление: границы слов суммируются в порядке курсоров, а
+        // релевантность - в порядке id слов, и сумма границ может оказаться на несколько ulp
+        // меньше релевантности, которую ограничивает. При релевантностях порядка единиц
+        // это ~1e-15, так что отсечение по threshold не теряет документов полного перебора
+        const double threshold = top.IsFull() ? top.Worst().relevance - 2 * MIN_ACCURACY
+                                              : -std::numeric_limits<double>::infinity();
+        // Опорный документ: первый, на котором сумма границ слов превышает порог
+        double upper_bound = 0.0;
+        size_t pivot = 0;
+        for (; pivot < ordered.size(); ++pivot) {
+            upper_bound += ordered[pivot]->upper_bound;
+            if (upper_bound > threshold) {
+                break;
+            }
+        }
+        if (pivot == ordered.size()) {
+            break;
+        }
+        const int pivot_id = ordered[pivot]->it->document_id;
+        size_t last = pivot;
+        while (last + 1 < ordered.size() && ordered[last + 1]->it->document_id == pivot_id) {
+            ++last;
+        }
+
+        // Уточнение по блокам: документы [pivot_id, next_id) содержат только слова ordered[0..last],
+        // и вклад каждого ограничен максимумом его текущего блока. Блок без документов
+        // принимаемых статусов ничего не вносит; если таковы все блоки, диапазон пропускается
+        int64_t next_id = last + 1 < ordered.size() ? ordered[last + 1]->it->document_id
+                                                    : int64_t{std::numeric_limits<int>::max()} + 1;
+        double block_upper_bound = 0.0;
+        bool has_accepted_block = false;
+        for (size_t i = 0; i <= last; ++i) {
+            const auto block = ordered[i]->it.GetBlockBound(pivot_id);
+            if (block.tag_mask & accepted_tags) {
+                block_upper_bound += ranking_model.UpperBound(ordered[i]->inverse_document_freq,
+                                                              block.max_term_freq);
+                has_accepted_block = true;
+            }
+            next_id = std::min(next_id, int64_t{block.last_id} + 1);
+        }
+        if (!has_accepted_block || block_upper_bound <= threshold) {
+            for (size_t i = 0; i <= last; ++i) {
+                skip_to(*ordered[i], next_id);
+            }
             continue;
         }
-        for (auto&& [document_id, relevance] : map) {
-            matched_documents[index++] = { document_id, relevance, _id_docdata_.at(document_id).rating };
+
+        if (ordered[0]->it->document_id != pivot_id) {
+            // Документы до pivot_id не могут превысить порог
+            for (size_t i = 0; i < pivot; ++i) {
+                skip_to(*ordered[i], pivot_id);
+            }
+            continue;
+        }
+
+        // Все курсоры до pivot стоят на pivot_id, номер документа - из записи первого
+        const Ordinal pivot_ordinal = ordered[0]->it->ordinal;
+        const DocumentNorms* norms = is_excluded(pivot_id) ? nullptr
+                                                           : FindAcceptedDocument(document_predicate, pivot_id,
+                                                                                  pivot_ordinal,
+                                                                                  ordered[0]->it.GetBlockTagMask());
+        if (norms) {
+            double relevance = 0.0;
+            for (const Cursor& cursor : cursors) {
+                if (cursor.it != cursor.end && cursor.it->document_id == pivot_id) {
+                    relevance += ranking_model.Score(cursor.inverse_document_freq, cursor.it->count, *norms);
+                }
+            }
+            top.Push({pivot_id, relevance, _ordinal_to_rating_[pivot_ordinal]});
+        }
+        for (size_t i = 0; i <= last; ++i) {
+            ++ordered[i]->it;
         }
     }
-    matched_documents.resize(index);
-    return matched_documents;
+    return std::move(top).Extract();
 }
 
-template <typename ExecutionPolicy>
+template <typename RankingModel, typename DocumentPredicate>
 std::vector<Document>
-SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query) const {
+SearchServer::FindTopDocumentsConjunctive(const Query& query, const std::vector<double>& plus_idf,
+                                          const RankingModel& ranking_model,
+                                          DocumentPredicate document_predicate, size_t top_count) const {
 
-    ConcurrentMap<int, double> document_to_relevance(10007); //10007 - подобранное эффективное значение
-    const auto it_end = _word_to__id_freq_.end();
-    for_each(policy,
-             query.plus_words.begin(), query.plus_words.end(),
-             [this, &document_to_relevance, &it_end](const auto word) {
-                 if (_word_to__id_freq_.find(word) != it_end) {
-                     //Заполнение ConcurrentMap данными по плюс-словам
-                     const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                     for(const auto& id_freq : _word_to__id_freq_.at(word)) {
-                         const int document_id = id_freq.first;
-                         const double term_freq = id_freq.second;
-                         document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                     }
-                 }
+    struct Cursor {
+        PostingList::Iterator it;
+        PostingList::Iterator end;
+        double inverse_document_freq;
+    };
+    if (top_count == 0) {
+        return {};
+    }
+    // Обязательные слова вместе со словами фраз, по возрастанию длины posting list:
+    // пересечение ведёт самый короткий, остальные догоняют его галопирующим SkipTo
+    std::vector<TermId> _required_terms = query.required_terms;
+    _required_terms.insert(_required_terms.end(), query.phrase_terms.begin(), query.phrase_terms.end());
+    std::sort(_required_terms.begin(), _required_terms.end());
+    _required_terms.erase(std::unique(_required_terms.begin(), _required_terms.end()), _required_terms.end());
+    std::stable_sort(_required_terms.begin(), _required_terms.end(),
+                     [this](const TermId lhs, const TermId rhs) {
+                         return _term_to_postings_[lhs].size() < _term_to_postings_[rhs].size();
+                     });
+    if (_term_to_postings_[_required_terms.front()].empty()) {
+        return {};
+    }
+    std::vector<Cursor> required;
+    for (const TermId term_id : _required_terms) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        required.push_back({postings.begin(), postings.end(), 0.0});
+    }
+    // Слова фраз - индексы курсоров в required
+    std::vector<std::vector<size_t>> _phrases_cursors;
+    for (size_t phrase_index = 0; phrase_index < query.GetPhraseCount(); ++phrase_index) {
+        std::vector<size_t>& _cursors = _phrases_cursors.emplace_back();
+        for (const TermId term_id : query.GetPhrase(phrase_index)) {
+            _cursors.push_back(std::find(_required_terms.begin(), _required_terms.end(), term_id)
+                               - _required_terms.begin());
+        }
+    }
+    // Курсоры плюс-слов в порядке id слов - в этом порядке суммирует и полный перебор
+    std::vector<Cursor> cursors;
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const PostingList& postings = _term_to_postings_[query.plus_terms[i]];
+        if (!postings.empty()) {
+            cursors.push_back({postings.begin(), postings.end(), plus_idf[i]});
+        }
+    }
+    std::vector<Cursor> minus_cursors;
+    for (const TermId term_id : query.minus_terms) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        minus_cursors.push_back({postings.begin(), postings.end(), 0.0});
+    }
+
+    const uint32_t accepted_tags = GetAcceptedStatusTags(document_predicate);
+    TopDocuments top(top_count);
+    std::vector<std::vector<uint32_t>> _word_positions;
+    Cursor& lead = required.front();
+    while (lead.it != lead.end) {
+        // Документ пересечения есть в списке ведущего курсора, поэтому его блоки без
+        // документов принимаемых статусов пропускаются
+        if ((lead.it.GetBlockTagMask() & accepted_tags) == 0) {
+            lead.it.NextBlock();
+            continue;
+        }
+        // Поиск документа, на котором сходятся все курсоры required
+        int candidate = lead.it->document_id;
+        bool is_found = true;
+        for (size_t i = 1; i < required.size();) {
+            Cursor& cursor = required[i];
+            cursor.it.SkipTo(candidate);
+            if (cursor.it == cursor.end) {
+                is_found = false;
+                break;
+            }
+            if (cursor.it->document_id == candidate) {
+                ++i;
+                continue;
+            }
+            lead.it.SkipTo(cursor.it->document_id);
+            if (lead.it == lead.end) {
+                is_found = false;
+                break;
+            }
+            candidate = lead.it->document_id;
+            i = 1;
+        }
+        if (!is_found) {
+            break;
+        }
+
+        const bool is_excluded = std::any_of(minus_cursors.begin(), minus_cursors.end(),
+                                             [candidate](Cursor& cursor) {
+                                                 cursor.it.SkipTo(candidate);
+                                                 return cursor.it != cursor.end
+                                                     && cursor.it->document_id == candidate;
+                                             });
+        const bool has_phrases = !is_excluded
+            && std::all_of(_phrases_cursors.begin(), _phrases_cursors.end(),
+                           [&required, &_word_positions](const std::vector<size_t>& _cursors) {
+                               _word_positions.resize(_cursors.size());
+                               for (size_t i = 0; i < _cursors.size(); ++i) {
+                                   required[_cursors[i]].it.GetPositions(_word_positions[i]);
+                               }
+                               return HasConsecutivePositions(_word_positions);
+                           });
+        if (has_phrases) {
+            const Ordinal ordinal = lead.it->ordinal;
+            if (const DocumentNorms* norms = FindAcceptedDocument(document_predicate, candidate, ordinal,
+                                                                  lead.it.GetBlockTagMask())) {
+                double relevance = 0.0;
+                for (Cursor& cursor : cursors) {
+                    cursor.it.SkipTo(candidate);
+                    if (cursor.it != cursor.end && cursor.it->document_id == candidate) {
+                        relevance += ranking_model.Score(cursor.inverse_document_freq, cursor.it->count, *norms);
+                    }
+                }
+                top.Push({candidate, relevance, _ordinal_to_rating_[ordinal]});
+            }
+        }
+        ++lead.it;
+    }
+    return std::move(top).Extract();
+}
+
+template <typename RankingModel, typename ExecutionPolicy, typename QueryContainer, typename DocumentPredicate>
+std::vector<std::vector<Document>>
+SearchServer::FindTopDocumentsBatch(ExecutionPolicy&& policy, const QueryContainer& raw_queries,
+                                    DocumentPredicate document_predicate, size_t top_count) const {
+
+    // Разбор последовательный: исключение о неверном запросе передаётся вызывающему
+    std::vector<Query> queries;
+    for (const auto& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(raw_query));
+    }
+    const size_t query_count = queries.size();
+    const RankingModel ranking_model(GetCorpusStatistics());
+
+    // Слова пакета без повторов, по возрастанию id - в этом порядке
+    // релевантность суммирует и одиночный запрос
+    // Запросы с обязательными словами и фразами выполняются отдельно, см. ниже
+    std::vector<std::tuple<TermId, bool, uint32_t>> _term_occurrences;    // слово, минус-слово, запрос
+    for (uint32_t query_index = 0; query_index < query_count; ++query_index) {
+        if (queries[query_index].IsConjunctive() || queries[query_index].is_unsatisfiable) {
+            continue;
+        }
+        for (const TermId term_id : queries[query_index].plus_terms) {
+            _term_occurrences.emplace_back(term_id, false, query_index);
+        }
+        for (const TermId term_id : queries[query_index].minus_terms) {
+            _term_occurrences.emplace_back(term_id, true, query_index);
+        }
+    }
+    std::sort(_term_occurrences.begin(), _term_occurrences.end());
+    std::vector<BatchTerm> batch_terms;
+    size_t posting_count = 0;
+    for (const auto& [term_id, is_minus, query_index] : _term_occurrences) {
+        const PostingList& postings = _term_to_postings_[term_id];
+        if (postings.empty()) {
+            continue;
+        }
+        if (batch_terms.empty() || batch_terms.back().term_id != term_id) {
+            batch_terms.push_back({term_id, ComputeWordInverseDocumentFreq(term_id), {}, {}});
+            posting_count += postings.size();
+        }
+        (is_minus ? batch_terms.back().minus_queries : batch_terms.back().plus_queries).push_back(query_index);
+    }
+
+    std::vector<std::vector<Document>> results(query_count);
+    if (_ordinals_.empty() || top_count == 0) {
+        return results;
+    }
+    // Диапазоны id документов обрабатываются независимо, каждый своим потоком
+    static constexpr size_t MIN_PART_POSTINGS = 16384;
+    size_t part_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        part_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                          posting_count / MIN_PART_POSTINGS));
+    }
+    const int64_t first_id = _ordinals_.GetFirstId();
+    const int64_t id_span = int64_t{_ordinals_.GetLastId()} - first_id + 1;
+    std::vector<std::vector<TopDocuments>> _parts_tops(part_count,
+                                                       std::vector<TopDocuments>(query_count, TopDocuments(top_count)));
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+    std::for_each(policy,
+                  parts.begin(), parts.end(),
+                  [&](const size_t part) {
+                      const int part_first_id = static_cast<int>(first_id + id_span * part / part_count);
+                      const int part_last_id = static_cast<int>(first_id + id_span * (part + 1) / part_count - 1);
+                      if (part_first_id <= part_last_id) {
+                          ScoreBatchRange(batch_terms, query_count, ranking_model, part_first_id, part_last_id,
+                                          document_predicate, _parts_tops[part]);
+                      }
     });
-    // Удаление данных по минус-словам
-    for_each(policy,
-             query.minus_words.begin(), query.minus_words.end(),
-             [this, &document_to_relevance, &it_end](const auto word) {
-                 if (_word_to__id_freq_.find(word) != it_end) {
-                     for (const auto& [document_id, freq] : _word_to__id_freq_.at(word)) {
-                         document_to_relevance.Erase(document_id);
-                     }
-
-                  }
+
+    for (size_t query_index = 0; query_index < query_count; ++query_index) {
+        for (size_t part = 1; part < part_count; ++part) {
+            _parts_tops[0][query_index].Merge(_parts_tops[part][query_index]);
+        }
+        results[query_index] = std::move(_parts_tops[0][query_index]).Extract();
+    }
+    for (size_t query_index = 0; query_index < query_count; ++query_index) {
+        const Query& query = queries[query_index];
+        if (query.IsConjunctive() || query.is_unsatisfiable) {
+            results[query_index] = RankDocuments(std::execution::seq, query, ComputePlusInverseDocumentFreqs(query),
+                                                 ranking_model, document_predicate, top_count);
+        }
+    }
+    return results;
+}
+
+template <typename RankingModel, typename DocumentPredicate>
+void SearchServer::ScoreBatchRange(const std::vector<BatchTerm>& batch_terms, size_t query_count,
+                                   const RankingModel& ranking_model,
+                                   int first_id, int last_id, DocumentPredicate& document_predicate,
+                                   std::vector<TopDocuments>& tops) const {
+
+    static constexpr uint8_t SCORED = 1;
+    static constexpr uint8_t EXCLUDED = 2;
+    // Плитка документов: оценки всех запросов по документам плитки
+    // (query_count * tile_size) должны помещаться в кеш
+    static constexpr size_t TILE_BYTES = 1 << 20;
+    const size_t tile_size = std::clamp<size_t>(TILE_BYTES / (query_count * (sizeof(double) + 1)), 64, 4096);
+
+    const uint32_t accepted_tags = GetAcceptedStatusTags(document_predicate);
+    std::vector<PostingList::Iterator> iterators;
+    iterators.reserve(batch_terms.size());
+    for (const BatchTerm& batch_term : batch_terms) {
+        iterators.push_back(_term_to_postings_[batch_term.term_id].begin());
+    }
+    std::vector<int> tile_ids;
+    std::vector<Ordinal> tile_ordinals;     // заполняются из записей posting lists
+    std::vector<double> scores;             // [запрос][документ плитки]
+    std::vector<uint8_t> _states;
+    std::vector<uint8_t> _touched;          // документ набрал релевантность хотя бы в одном запросе
+
+    auto it_id = _ordinals_.LowerBound(first_id);
+    while (it_id != _ordinals_.end() && *it_id <= last_id) {
+        tile_ids.clear();
+        for (; it_id != _ordinals_.end() && *it_id <= last_id && tile_ids.size() < tile_size; ++it_id) {
+            tile_ids.push_back(*it_id);
+        }
+        const size_t tile_length = tile_ids.size();
+        tile_ordinals.resize(tile_length);
+        const int tile_first_id = tile_ids.front();
+        const int tile_last_id = tile_ids.back();
+        // При сплошных id позиция документа в плитке вычисляется без поиска
+        const bool is_contiguous = int64_t{tile_last_id} - tile_first_id + 1 == static_cast<int64_t>(tile_length);
+        auto get_slot = [&](const int document_id) -> size_t {
+            return is_contiguous ? document_id - tile_first_id
+                                 : std::lower_bound(tile_ids.begin(), tile_ids.end(), document_id) - tile_ids.begin();
+        };
+        scores.assign(query_count * tile_length, 0.0);
+        _states.assign(query_count * tile_length, 0);
+        _touched.assign(tile_length, 0);
+
+        for (size_t i = 0; i < batch_terms.size(); ++i) {
+            const BatchTerm& batch_term = batch_terms[i];
+            PostingList::Iterator& it = iterators[i];
+            const PostingList::Iterator it_end = _term_to_postings_[batch_term.term_id].end();
+            it.SkipTo(tile_first_id);
+            while (it != it_end && it->document_id <= tile_last_id) {
+                if ((it.GetBlockTagMask() & accepted_tags) == 0) {
+                    // Документы блока не пройдут предикат
+                    it.NextBlock();
+                    continue;
+                }
+                const size_t slot = get_slot(it->document_id);
+                tile_ordinals[slot] = it->ordinal;
+                const double relevance = ranking_model.Score(batch_term.inverse_document_freq, it->count,
+                                                             _ordinal_to_norms_[it->ordinal]);
+                for (const uint32_t query_index : batch_term.plus_queries) {
+                    scores[query_index * tile_length + slot] += relevance;
+                    _states[query_index * tile_length + slot] |= SCORED;
+                }
+                for (const uint32_t query_index : batch_term.minus_queries) {
+                    _states[query_index * tile_length + slot] |= EXCLUDED;
+                }
+                _touched[slot] |= !batch_term.plus_queries.empty();
+                ++it;
+            }
+        }
+
+        // Предикат вычисляется один раз на документ; номера есть у всех затронутых документов
+        for (size_t slot = 0; slot < tile_length; ++slot) {
+            if (_touched[slot]) {
+                const Ordinal ordinal = tile_ordinals[slot];
+                _touched[slot] = document_predicate(tile_ids[slot], _ordinal_to_status_[ordinal],
+                                                    _ordinal_to_rating_[ordinal]);
+            }
+        }
+        for (size_t query_index = 0; query_index < query_count; ++query_index) {
+            const uint8_t* _query_states = _states.data() + query_index * tile_length;
+            for (size_t slot = 0; slot < tile_length; ++slot) {
+                if (_query_states[slot] == SCORED && _touched[slot]) {
+                    tops[query_index].Push({tile_ids[slot], scores[query_index * tile_length + slot],
+                                            _ordinal_to_rating_[tile_ordinals[slot]]});
+                }
+            }
+        }
+    }
+}
+
+template <typename ExecutionPolicy, typename DocumentContainer>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const DocumentContainer& documents) {
+
+    // Документы по возрастанию id
+    std::vector<const NewDocument*> _sorted_documents;
+    for (const NewDocument& document : documents) {
+        if (document.id < 0) {
+            throw std::invalid_argument("Id less then null"s);
+        }
+        if (_ordinals_.Contains(document.id)) {
+            throw std::invalid_argument("This id exist already"s);
+        }
+        _sorted_documents.push_back(&document);
+    }
+    std::sort(_sorted_documents.begin(), _sorted_documents.end(),
+              [](const NewDocument* lhs, const NewDocument* rhs) { return lhs->id < rhs->id; });
+    if (std::adjacent_find(_sorted_documents.begin(), _sorted_documents.end(),
+                           [](const NewDocument* lhs, const NewDocument* rhs) { return lhs->id == rhs->id; })
+        != _sorted_documents.end()) {
+        throw std::invalid_argument("This id exist already"s);
+    }
+    if (_sorted_documents.empty()) {
+        return;
+    }
+
+    // Части - отрезки _sorted_documents с примерно равным объёмом текста
+    static constexpr size_t MIN_PART_DOCUMENTS = 256;
+    size_t part_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        part_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                          _sorted_documents.size() / MIN_PART_DOCUMENTS));
+    }
+    std::vector<size_t> _part_begins{0};
+    {
+        size_t total_size = 0;
+        for (const NewDocument* document : _sorted_documents) {
+            total_size += document->text.size() + 1;
+        }
+        size_t size = 0;
+        for (size_t i = 0; i < _sorted_documents.size() && _part_begins.size() < part_count; ++i) {
+            size += _sorted_documents[i]->text.size() + 1;
+            if (size * part_count >= total_size * _part_begins.size()) {
+                _part_begins.push_back(i + 1);
+            }
+        }
+        _part_begins.push_back(_sorted_documents.size());
+        part_count = _part_begins.size() - 1;
+    }
+
+    // Номера документов известны заранее, но занимаются только после успешного разбора,
+    // поэтому при исключении индекс не изменяется
+    std::vector<int> _ids(_sorted_documents.size());
+    std::transform(_sorted_documents.begin(), _sorted_documents.end(), _ids.begin(),
+                   [](const NewDocument* document) { return document->id; });
+    const std::vector<Ordinal> next_ordinals = _ordinals_.GetNextOrdinals(_ids.size());
+
+    // Частичный индекс части: слова части получают локальные id в порядке появления. Слова
+    // общего словаря ищутся в нём сразу (во время разбора он только читается), в собственный
+    // словарь части попадают лишь новые слова. Posting lists кодируются сразу с номерами
+    // документов и дописываются к общим целиком
+    struct PartialIndex {
+        std::vector<TermId> _term_ids;              // локальный id -> общий, NO_TERM - новое слово
+        std::vector<uint32_t> _known_to_local;      // общий id -> локальный, NO_TERM - не встречалось
+        TermDictionary new_terms;
+        std::vector<uint32_t> _new_to_local;        // id в new_terms -> локальный
+        std::vector<PostingList> _term_to_postings;
+        std::vector<DocumentData> _documents;       // в _term_counts_ - локальные id до слияния словарей
+        std::exception_ptr error;
+
+        // Локальный id слова, dictionary - общий словарь
+        uint32_t GetLocalTerm(const TermDictionary& dictionary, std::string_view word) {
+            const TermId term_id = dictionary.Find(word);
+            if (term_id != TermDictionary::NO_TERM) {
+                uint32_t& local = _known_to_local[term_id];
+                if (local == TermDictionary::NO_TERM) {
+                    local = static_cast<uint32_t>(_term_ids.size());
+                    _term_ids.push_back(term_id);
+                }
+                return local;
+            }
+            const TermId new_term = new_terms.Intern(word);
+            if (new_term == _new_to_local.size()) {
+                _new_to_local.push_back(static_cast<uint32_t>(_term_ids.size()));
+                _term_ids.push_back(TermDictionary::NO_TERM);
+            }
+            return _new_to_local[new_term];
+        }
+    };
+    std::vector<PartialIndex> _partial_indexes(part_count);
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+
+    std::for_each(policy,
+                  parts.begin(), parts.end(),
+                  [&](const size_t part) {
+                      PartialIndex& index = _partial_indexes[part];
+                      // Исключение из потока параллельного алгоритма завершило бы программу
+                      try {
+                          index._known_to_local.assign(_dictionary_.size(), TermDictionary::NO_TERM);
+                          std::vector<std::pair<uint32_t, uint32_t>> term_positions;
+                          std::vector<uint32_t> positions;
+                          std::vector<std::pair<TermId, uint32_t>> term_counts;
+                          index._documents.reserve(_part_begins[part + 1] - _part_begins[part]);
+                          for (size_t i = _part_begins[part]; i < _part_begins[part + 1]; ++i) {
+                              const NewDocument& document = *_sorted_documents[i];
+                              const std::vector<std::string_view> words = SplitIntoWordsNoStop(document.text);
+                              const double inv_word_count = 1.0 / words.size();
+                              term_positions.resize(words.size());
+                              for (uint32_t position = 0; position < words.size(); ++position) {
+                                  term_positions[position] = {index.GetLocalTerm(_dictionary_, words[position]), position};
+                              }
+                              if (index._term_to_postings.size() < index._term_ids.size()) {
+                                  index._term_to_postings.resize(index._term_ids.size());
+                              }
+                              std::sort(term_positions.begin(), term_positions.end());
+
+                              term_counts.clear();
+                              for (auto it = term_positions.begin(); it != term_positions.end();) {
+                                  const uint32_t term = it->first;
+                                  positions.clear();
+                                  for (; it != term_positions.end() && it->first == term; ++it) {
+                                      positions.push_back(it->second);
+                                  }
+                                  const uint32_t count = static_cast<uint32_t>(positions.size());
+                                  index._term_to_postings[term].Add(document.id, next_ordinals[i],
+                                                                    GetStatusTag(document.status), positions,
+                                                                    count * inv_word_count);
+                                  term_counts.emplace_back(term, count);
+                              }
+                              // Копия точного размера: данные документов живут до конца слияния
+                              index._documents.push_back({ComputeAverageRating(document.ratings), document.status,
+                                                          {static_cast<double>(words.size()), inv_word_count},
+                                                          {term_counts.begin(), term_counts.end()}});
+                          }
+                      } catch (...) {
+                          index.error = std::current_exception();
+                      }
     });
-    // Заполнение отмеченными документами (с использованием поля bucket_ класса ConcurrentMap)
-    std::vector<Document> matched_documents(document_to_relevance.bucket_.size());
-    std::atomic_uint index = 0;
-    for (auto&& [mutex, map] : document_to_relevance.bucket_) {
-        //std::lock_guard guard(mutex);
-        if (map.empty()) {
-            continue;
+    for (const PartialIndex& index : _partial_indexes) {
+        if (index.error) {
+            std::rethrow_exception(index.error);
         }
-        for (auto&& [document_id, relevance] : map) {
-            matched_documents[index++] = { document_id, relevance, _id_docdata_.at(document_id).rating };
+    }
+
+    // В общий словарь добавляются только новые слова: их повторы между частями отбрасываются
+    // сортировкой, и каждое новое слово добавляется один раз, в порядке первого появления
+    // в пачке - как при добавлении документов по одному
+    struct NewTerm {
+        std::string_view word;
+        uint32_t part;
+        uint32_t term;      // локальный id
+    };
+    std::vector<NewTerm> _new_terms;
+    for (uint32_t part = 0; part < part_count; ++part) {
+        const PartialIndex& index = _partial_indexes[part];
+        for (uint32_t new_term = 0; new_term < index._new_to_local.size(); ++new_term) {
+            _new_terms.push_back({index.new_terms.GetTerm(new_term), part, index._new_to_local[new_term]});
         }
     }
-    matched_documents.resize(index);
-    return matched_documents;
+    if (part_count > 1) {
+        const auto by_source = [](const NewTerm& lhs, const NewTerm& rhs) {
+            return std::tie(lhs.part, lhs.term) < std::tie(rhs.part, rhs.term);
+        };
+        std::sort(policy, _new_terms.begin(), _new_terms.end(),
+                  [&by_source](const NewTerm& lhs, const NewTerm& rhs) {
+                      return lhs.word != rhs.word ? lhs.word < rhs.word : by_source(lhs, rhs);
+                  });
+        _new_terms.erase(std::unique(_new_terms.begin(), _new_terms.end(),
+                                     [](const NewTerm& lhs, const NewTerm& rhs) { return lhs.word == rhs.word; }),
+                         _new_terms.end());
+        std::sort(policy, _new_terms.begin(), _new_terms.end(), by_source);
+    }
+    for (const NewTerm& new_term : _new_terms) {
+        _partial_indexes[new_term.part]._term_ids[new_term.term] = _dictionary_.Intern(new_term.word);
+    }
+    if (_term_to_postings_.size() < _dictionary_.size()) {
+        _term_to_postings_.resize(_dictionary_.size());
+    }
+
+    // Слова документов переводятся в общие id параллельно (id повторов новых слов ищутся
+    // в общем словаре заново). Порядок слов документа сохраняется, если общие id возрастают
+    // вместе с локальными (например, все слова части новые), иначе слова сортируются.
+    // Заодно собираются источники posting lists - (id слова, часть, локальный id)
+    std::vector<size_t> _source_begins{0};
+    for (const PartialIndex& index : _partial_indexes) {
+        _source_begins.push_back(_source_begins.back() + index._term_ids.size());
+    }
+    std::vector<std::tuple<TermId, uint32_t, uint32_t>> _term_sources(_source_begins.back());
+    std::for_each(policy,
+                  parts.begin(), parts.end(),
+                  [&](const size_t part) {
+                      PartialIndex& index = _partial_indexes[part];
+                      std::vector<TermId>& _term_ids = index._term_ids;
+                      for (uint32_t new_term = 0; new_term < index._new_to_local.size(); ++new_term) {
+                          TermId& term_id = _term_ids[index._new_to_local[new_term]];
+                          if (term_id == TermDictionary::NO_TERM) {
+                              term_id = _dictionary_.Find(index.new_terms.GetTerm(new_term));
+                          }
+                      }
+                      for (uint32_t term = 0; term < _term_ids.size(); ++term) {
+                          _term_sources[_source_begins[part] + term] = {_term_ids[term], static_cast<uint32_t>(part), term};
+                      }
+                      const bool is_order_kept = std::is_sorted(_term_ids.begin(), _term_ids.end());
+                      for (DocumentData& doc_data : index._documents) {
+                          for (auto& [term_id, count] : doc_data._term_counts_) {
+                              term_id = _term_ids[term_id];
+                          }
+                          if (!is_order_kept) {
+                              std::sort(doc_data._term_counts_.begin(), doc_data._term_counts_.end());
+                          }
+                      }
+    });
+    std::sort(policy, _term_sources.begin(), _term_sources.end());
+
+    const std::vector<Ordinal> ordinals = _ordinals_.Add(_ids);
+    std::vector<const DocumentData*> _documents;
+    _documents.reserve(_ids.size());
+    for (const PartialIndex& index : _partial_indexes) {
+        for (const DocumentData& doc_data : index._documents) {
+            _documents.push_back(&doc_data);
+        }
+    }
+    SetDocumentsData(policy, ordinals, _documents);
+
+    // Части идут по возрастанию id, поэтому их posting lists обычно дописываются в конец общих
+    // байтами; если в индексе уже есть большие id, записи добавляются по одной. Слова различны, поэтому потоки изменяют разные posting lists
+    std::vector<size_t> _term_begins;
+    for (size_t i = 0; i < _term_sources.size(); ++i) {
+        if (i == 0 || std::get<0>(_term_sources[i]) != std::get<0>(_term_sources[i - 1])) {
+            _term_begins.push_back(i);
+        }
+    }
+    std::for_each(policy,
+                  _term_begins.begin(), _term_begins.end(),
+                  [&](const size_t begin) {
+                      const TermId term_id = std::get<0>(_term_sources[begin]);
+                      PostingList& postings = _term_to_postings_[term_id];
+                      std::vector<uint32_t> positions;
+                      for (size_t i = begin; i < _term_sources.size() && std::get<0>(_term_sources[i]) == term_id; ++i) {
+                          const auto [_, part, term] = _term_sources[i];
+                          PostingList& part_postings = _partial_indexes[part]._term_to_postings[term];
+                          if (postings.Append(std::move(part_postings))) {
+                              continue;
+                          }
+                          for (auto it = part_postings.begin(); it != part_postings.end(); ++it) {
+                              it.GetPositions(positions);
+                              postings.Add(it->document_id, it->ordinal, GetStatusTag(_ordinal_to_status_[it->ordinal]),
+                                           positions, it->count * _ordinal_to_norms_[it->ordinal].inv_word_count);
+                          }
+                      }
+    });
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::SetDocumentsData(ExecutionPolicy&& policy, const std::vector<Ordinal>& ordinals,
+                                    const std::vector<const DocumentData*>& documents) {
+    ResizeDocumentColumns();
+    ++generation_;
+    std::vector<uint32_t> sizes(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        sizes[i] = static_cast<uint32_t>(documents[i]->_term_counts_.size());
+        word_count_ += static_cast<int64_t>(documents[i]->norms.word_count);
+    }
+    const std::vector<size_t> offsets = _forward_index_.Allocate(ordinals, sizes);
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy,
+                  indexes.begin(), indexes.end(),
+                  [&](const size_t i) {
+                      const DocumentData& doc_data = *documents[i];
+                      _ordinal_to_rating_[ordinals[i]] = doc_data.rating;
+                      _ordinal_to_status_[ordinals[i]] = doc_data.status;
+                      _ordinal_to_norms_[ordinals[i]] = doc_data.norms;
+                      _forward_index_.Write(offsets[i], doc_data._term_counts_);
+    });
 }
 
 template<typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
 
-    const std::map<std::string_view, double>& _word_freq = _id_to__word_freq_.at(document_id);
-    if (_word_freq.empty()) {
-        throw std::invalid_argument("Id is wrong"s);
-    }
-    std::vector<std::string_view> words(_word_freq.size());
-    transform(policy,
-              _word_freq.begin(), _word_freq.end(),
-              words.begin(),
-              [](const std::pair<std::string_view, double> word_freq) {
-                  return word_freq.first;
-              }
-    );
+    const Ordinal ordinal = GetOrdinal(document_id);
+    const auto _terms = _forward_index_.GetTerms(ordinal);
+    // Слова документа различны, поэтому потоки изменяют разные posting lists
     for_each(policy,
-             words.begin(), words.end(),
-             [this, document_id](const std::string_view word) {
-                 _word_to__id_freq_.at(word).erase(document_id);
+             _terms.begin(), _terms.end(),
+             [this, document_id](const TermId term_id) {
+                 _term_to_postings_[term_id].Erase(document_id);
              }
     );
-    _id_docdata_.erase(document_id);
-    _id_to__word_freq_.erase(document_id);
-    _id_.erase(document_id);
+    ReleaseDocumentData(ordinal);
+    _ordinals_.Remove(document_id);
+}
+
+template <typename ExecutionPolicy, typename IdContainer>
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy, const IdContainer& document_ids) {
+
+    std::vector<int> _ids(std::begin(document_ids), std::end(document_ids));
+    std::sort(_ids.begin(), _ids.end());
+    _ids.erase(std::unique(_ids.begin(), _ids.end()), _ids.end());
+    // Пары (id слова, id документа) всех удаляемых документов
+    std::vector<std::pair<TermId, int>> _term_documents;
+    for (const int document_id : _ids) {
+        for (const TermId term_id : _forward_index_.GetTerms(GetOrdinal(document_id))) {
+            _term_documents.emplace_back(term_id, document_id);
+        }
+    }
+    std::sort(policy, _term_documents.begin(), _term_documents.end());
+
+    std::vector<size_t> _term_begins;
+    for (size_t i = 0; i < _term_documents.size(); ++i) {
+        if (i == 0 || _term_documents[i].first != _term_documents[i - 1].first) {
+            _term_begins.push_back(i);
+        }
+    }
+    // Слова различны, поэтому потоки изменяют разные posting lists
+    std::for_each(policy,
+                  _term_begins.begin(), _term_begins.end(),
+                  [this, &_term_documents](const size_t begin) {
+                      const TermId term_id = _term_documents[begin].first;
+                      std::vector<int> _removed_ids;
+                      for (size_t i = begin; i < _term_documents.size() && _term_documents[i].first == term_id; ++i) {
+                          _removed_ids.push_back(_term_documents[i].second);
+                      }
+                      _term_to_postings_[term_id].Erase(_removed_ids);
+    });
+
+    for (const int document_id : _ids) {
+        ReleaseDocumentData(_ordinals_.Find(document_id));
+    }
+    _ordinals_.Remove(_ids);
+}
+
+template <typename DocumentFilter>
+void SearchServer::MergeFrom(const SearchServer& other, DocumentFilter keep_document) {
+
+    // id слов other -> id слов этого индекса
+    std::vector<TermId> term_map(other._dictionary_.size());
+    for (TermId term_id = 0; term_id < term_map.size(); ++term_id) {
+        term_map[term_id] = _dictionary_.Intern(other._dictionary_.GetTerm(term_id));
+    }
+    if (_term_to_postings_.size() < _dictionary_.size()) {
+        _term_to_postings_.resize(_dictionary_.size());
+    }
+
+    // Переносимые документы по возрастанию id
+    std::vector<int> _ids;
+    for (const int document_id : other._ordinals_) {
+        if (!keep_document(document_id)) {
+            continue;
+        }
+        if (_ordinals_.Contains(document_id)) {
+            throw std::invalid_argument("This id exist already"s);
+        }
+        _ids.push_back(document_id);
+    }
+    const std::vector<Ordinal> ordinals = _ordinals_.Add(_ids);
+    // Номер документа в other -> номер в этом индексе, NO_ORDINAL - документ не переносится
+    std::vector<Ordinal> ordinal_map(other._ordinals_.GetCapacity(), DocumentOrdinals::NO_ORDINAL);
+    for (size_t i = 0; i < _ids.size(); ++i) {
+        const Ordinal other_ordinal = other._ordinals_.Find(_ids[i]);
+        ordinal_map[other_ordinal] = ordinals[i];
+        const auto _other_terms = other._forward_index_.GetTerms(other_ordinal);
+        const auto other_counts = other._forward_index_.GetCounts(other_ordinal);
+        DocumentData doc_data{other._ordinal_to_rating_[other_ordinal], other._ordinal_to_status_[other_ordinal],
+                              other._ordinal_to_norms_[other_ordinal], {}};
+        doc_data._term_counts_.reserve(_other_terms.size());
+        for (size_t j = 0; j < _other_terms.size(); ++j) {
+            doc_data._term_counts_.emplace_back(term_map[_other_terms.begin()[j]], other_counts[j]);
+        }
+        std::sort(doc_data._term_counts_.begin(), doc_data._term_counts_.end());
+        SetDocumentData(ordinals[i], doc_data);
+    }
+
+    // Posting lists переносятся целиком по словам, документы каждого слова идут по возрастанию id
+    std::vector<uint32_t> positions;
+    for (TermId other_term_id = 0; other_term_id < other._term_to_postings_.size(); ++other_term_id) {
+        PostingList& postings = _term_to_postings_[term_map[other_term_id]];
+        const PostingList& other_postings = other._term_to_postings_[other_term_id];
+        for (auto it = other_postings.begin(); it != other_postings.end(); ++it) {
+            const Ordinal ordinal = ordinal_map[it->ordinal];
+            if (ordinal != DocumentOrdinals::NO_ORDINAL) {
+                const double inv_word_count = other._ordinal_to_norms_[it->ordinal].inv_word_count;
+                it.GetPositions(positions);
+                postings.Add(it->document_id, ordinal, GetStatusTag(other._ordinal_to_status_[it->ordinal]), positions,
+                             it->count * inv_word_count);
+            }
+        }
+    }
 }
 
 //----------END OF CLASS--------------
@@ -0,0 +1,29 @@
+#include "stop_word_set.h"
+
+using namespace std;
+
+StopWordSet::StopWordSet(const std::vector<std::string_view>& words) {
+    for (const std::string_view word : words) {
+        if (!word.empty()) {
+            _words_.emplace_back(word);
+        }
+    }
+    sort(_words_.begin(), _words_.end());
+    _words_.erase(unique(_words_.begin(), _words_.end()), _words_.end());
+
+    size_t slot_count = 1;
+    while (slot_count < 2 * _words_.size()) {
+        slot_count *= 2;
+    }
+    _slots_.assign(slot_count, Slot{0, 0});
+    for (size_t index = 0; index < _words_.size(); ++index) {
+        const std::string& word = _words_[index];
+        const uint32_t hash = Hash(word);
+        size_t i = hash & (slot_count - 1);
+        while (_slots_[i].word_index != 0) {
+            i = (i + 1) & (slot_count - 1);
+        }
+        _slots_[i] = {hash, static_cast<uint32_t>(index + 1)};
+        length_mask_ |= uint64_t{1} << std::min<size_t>(word.size(), 63);
+    }
+}
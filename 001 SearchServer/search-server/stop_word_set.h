@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемое множество стоп-слов. Проверка слова не выделяет память:
+// слова, длины которых нет среди стоп-слов, отсекаются по маске длин,
+// остальные ищутся в таблице с открытой адресацией (линейное пробирование,
+// заполнена не более чем наполовину), где рядом со словом хранится его хеш.
+class StopWordSet
+{
+public:
+    StopWordSet() = default;
+
+    // Пустые слова и повторы пропускаются
+    explicit StopWordSet(const std::vector<std::string_view>& words);
+
+    bool Contains(std::string_view word) const {
+        if ((length_mask_ >> std::min<size_t>(word.size(), 63) & 1) == 0) {
+            return false;
+        }
+        const uint32_t hash = Hash(word);
+        const size_t mask = _slots_.size() - 1;
+        for (size_t i = hash & mask; _slots_[i].word_index != 0; i = (i + 1) & mask) {
+            if (_slots_[i].hash == hash && _words_[_slots_[i].word_index - 1] == word) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Слова по алфавиту
+    const std::vector<std::string>& GetWords() const {
+        return _words_;
+    }
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t word_index;    // индекс в _words_ + 1, 0 - пустой слот
+    };
+
+    std::vector<std::string> _words_;
+    std::vector<Slot> _slots_;      // размер - степень двойки
+    uint64_t length_mask_ = 0;      // бит min(длина, 63) для длины каждого слова
+
+    // FNV-1a
+    static uint32_t Hash(std::string_view word) {
+        uint32_t hash = 2166136261u;
+        for (const char c : word) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        return hash;
+    }
+};
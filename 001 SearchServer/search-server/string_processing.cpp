@@ -1,8 +1,14 @@
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <execution>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #include "string_processing.h"
 
 using namespace std;
@@ -10,15 +16,134 @@ using namespace std;
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
     std::vector<std::string_view> words;
-    size_t first = text.find_first_not_of(' ', 0);
+    SplitIntoWords(text, words);
+    return words;
+}
+
+void SplitIntoWords(std::string_view text, std::vector<std::string_view>& words) {
+    TokenizeWords(text, words);
+}
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+
+// Бит i - признак байта i блока из BLOCK_SIZE байт
+struct BlockMasks {
+    uint64_t spaces;
+    uint64_t controls;
+};
 
-    while(first < text.size()) {
-        size_t second = text.find_first_of(' ', first);
+#if defined(__GNUC__) && defined(__x86_64__)
 
-        if (first != second) {
-            words.emplace_back(text.substr(first, second - first));
+BlockMasks ClassifyBlockSse2(const char* block) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i max_control = _mm_set1_epi8(' ' - 1);
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < BLOCK_SIZE; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        const uint64_t spaces = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)));
+        // Без знака: байт <= 0x1F, если min(байт, 0x1F) == байт
+        const uint64_t controls = static_cast<uint16_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, max_control), bytes)));
+        masks.spaces |= spaces << i;
+        masks.controls |= controls << i;
+    }
+    return masks;
+}
+
+__attribute__((target("avx2")))
+BlockMasks ClassifyBlockAvx2(const char* block) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i max_control = _mm256_set1_epi8(' ' - 1);
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < BLOCK_SIZE; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        const uint64_t spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)));
+        const uint64_t controls = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(bytes, max_control), bytes)));
+        masks.spaces |= spaces << i;
+        masks.controls |= controls << i;
+    }
+    return masks;
+}
+
+#else
+
+BlockMasks ClassifyBlockScalar(const char* block) {
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        const uint8_t c = static_cast<uint8_t>(block[i]);
+        masks.spaces |= uint64_t{c == ' '} << i;
+        masks.controls |= uint64_t{c < ' '} << i;
+    }
+    return masks;
+}
+
+#endif
+
+using ClassifyBlockFunction = BlockMasks (*)(const char* block);
+
+ClassifyBlockFunction SelectClassifyBlock() {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ClassifyBlockAvx2;
+    }
+    return ClassifyBlockSse2;
+#else
+    return ClassifyBlockScalar;
+#endif
+}
+
+const ClassifyBlockFunction classify_block = SelectClassifyBlock();
+
+int CountTrailingZeros(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    for (; (bits & 1) == 0; bits >>= 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+}  // namespace
+
+bool TokenizeWords(std::string_view text, std::vector<std::string_view>& words) {
+    words.clear();
+    uint64_t controls = 0;
+    size_t word_start = 0;
+    bool in_word = false;       // последний просмотренный байт - не пробел
+    for (size_t offset = 0; offset < text.size(); offset += BLOCK_SIZE) {
+        BlockMasks masks;
+        if (text.size() - offset >= BLOCK_SIZE) {
+            masks = classify_block(text.data() + offset);
+        } else {
+            // Хвост дополняется пробелами: они завершают последнее слово
+            char block[BLOCK_SIZE];
+            std::memset(block, ' ', BLOCK_SIZE);
+            std::memcpy(block, text.data() + offset, text.size() - offset);
+            masks = classify_block(block);
+        }
+        controls |= masks.controls;
+        // Границы слов - байты, которые отличаются от предыдущего тем, пробел ли это
+        uint64_t boundaries = masks.spaces ^ (masks.spaces << 1 | uint64_t{!in_word});
+        while (boundaries != 0) {
+            const size_t position = offset + CountTrailingZeros(boundaries);
+            if (in_word) {
+                words.emplace_back(text.data() + word_start, position - word_start);
+            } else {
+                word_start = position;
+            }
+            in_word = !in_word;
+            boundaries &= boundaries - 1;
         }
-        first = text.find_first_not_of(' ', second);
     }
-    return words;
+    if (in_word) {
+        words.emplace_back(text.data() + word_start, text.size() - word_start);
+    }
+    return controls == 0;
 }
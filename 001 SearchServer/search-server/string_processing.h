@@ -11,6 +11,15 @@ using namespace std::string_literals;
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Слова text записываются в words вместо прежнего содержимого
+void SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
+
+// То же, что SplitIntoWords(text, words), и за тот же проход проверяет, что в text
+// нет управляющих символов (0x00 - 0x1F). Возвращает false, если они есть:
+// тогда в words есть недопустимые слова. Текст просматривается блоками по 64 байта
+// командами AVX2 или SSE2, если процессор их поддерживает, иначе побайтно.
+bool TokenizeWords(std::string_view text, std::vector<std::string_view>& words);
+
 template <typename StringContainer>
 std::vector<std::string_view> MakeUniqueNonEmptyStrings(const StringContainer& strings)
 {
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "term_dictionary.h"
+
+using namespace std;
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    : _chunks_(other._chunks_)
+    , _terms_(other._terms_)
+    , _word_to_id_(other._word_to_id_)
+{}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        _chunks_ = other._chunks_;
+        chunk_pos_ = nullptr;
+        chunk_left_ = 0;
+        _terms_ = other._terms_;
+        _word_to_id_ = other._word_to_id_;
+    }
+    return *this;
+}
+
+TermDictionary::TermDictionary(TermDictionary&& other) noexcept
+    : _chunks_(std::move(other._chunks_))
+    , chunk_pos_(std::exchange(other.chunk_pos_, nullptr))
+    , chunk_left_(std::exchange(other.chunk_left_, 0))
+    , _terms_(std::move(other._terms_))
+    , _word_to_id_(std::move(other._word_to_id_))
+{
+    other._chunks_.clear();
+    other._terms_.clear();
+    other._word_to_id_.clear();
+}
+
+TermDictionary& TermDictionary::operator=(TermDictionary&& other) noexcept {
+    if (this != &other) {
+        _chunks_ = std::move(other._chunks_);
+        chunk_pos_ = std::exchange(other.chunk_pos_, nullptr);
+        chunk_left_ = std::exchange(other.chunk_left_, 0);
+        _terms_ = std::move(other._terms_);
+        _word_to_id_ = std::move(other._word_to_id_);
+        other._chunks_.clear();
+        other._terms_.clear();
+        other._word_to_id_.clear();
+    }
+    return *this;
+}
+
+TermDictionary::TermId TermDictionary::Intern(std::string_view word) {
+    const auto it = _word_to_id_.find(word);
+    if (it != _word_to_id_.end()) {
+        return it->second;
+    }
+    if (word.size() > chunk_left_) {
+        const size_t chunk_size = std::max(CHUNK_SIZE, word.size());
+        std::shared_ptr<char[]> chunk(new char[chunk_size]);
+        chunk_pos_ = chunk.get();
+        chunk_left_ = chunk_size;
+        _chunks_.push_back(std::move(chunk));
+    }
+    memcpy(chunk_pos_, word.data(), word.size());
+    const std::string_view stored(chunk_pos_, word.size());
+    chunk_pos_ += word.size();
+    chunk_left_ -= word.size();
+
+    const TermId term_id = static_cast<TermId>(_terms_.size());
+    _terms_.push_back(stored);
+    _word_to_id_.emplace(stored, term_id);
+    return term_id;
+}
+
+TermDictionary::TermId TermDictionary::Find(std::string_view word) const {
+    const auto it = _word_to_id_.find(word);
+    return it == _word_to_id_.end() ? NO_TERM : it->second;
+}
+
+void TermDictionary::AddExternalTerms(const std::shared_ptr<const void>& storage,
+                                      const std::vector<std::string_view>& words) {
+    // Внешняя память хранится среди блоков арены (aliasing shared_ptr)
+    _chunks_.push_back(std::shared_ptr<const char[]>(storage, static_cast<const char*>(storage.get())));
+    _terms_.reserve(_terms_.size() + words.size());
+    _word_to_id_.reserve(_word_to_id_.size() + words.size());
+    for (const std::string_view word : words) {
+        const TermId term_id = static_cast<TermId>(_terms_.size());
+        _terms_.push_back(word);
+        _word_to_id_.emplace(word, term_id);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Словарь слов индекса: каждое различное слово хранится один раз в арене
+// и получает плотный числовой id (0, 1, 2, ...) в порядке добавления.
+// Арена не перемещает строки, поэтому string_view на слова словаря
+// остаются валидными всё время жизни словаря (и его копий).
+class TermDictionary
+{
+public:
+    using TermId = uint32_t;
+    static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+    // Перемещённый словарь пуст: его указатель на свободное место блока
+    // не должен вести в блоки, которыми теперь владеет приёмник
+    TermDictionary(TermDictionary&& other) noexcept;
+    TermDictionary& operator=(TermDictionary&& other) noexcept;
+
+    // Возвращает id слова, при отсутствии добавляет его в словарь
+    TermId Intern(std::string_view word);
+
+    // NO_TERM, если слова нет в словаре
+    TermId Find(std::string_view word) const;
+
+    // Добавляет без копирования слова, лежащие во внешней памяти (отображённый файл индекса),
+    // которую storage держит всё время жизни словаря. Слова получают id size(), size() + 1, ...
+    // по порядку и не должны повторяться.
+    void AddExternalTerms(const std::shared_ptr<const void>& storage, const std::vector<std::string_view>& words);
+
+    std::string_view GetTerm(TermId term_id) const {
+        return _terms_[term_id];
+    }
+
+    size_t size() const {
+        return _terms_.size();
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    // Блоки арены разделяются копиями словаря: копия дописывает новые слова
+    // только в свои собственные блоки
+    std::vector<std::shared_ptr<const char[]>> _chunks_;
+    char* chunk_pos_ = nullptr;
+    size_t chunk_left_ = 0;
+
+    std::vector<std::string_view> _terms_;
+    std::unordered_map<std::string_view, TermId> _word_to_id_;
+};
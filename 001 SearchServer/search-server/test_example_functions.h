@@ -1,10 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
 #include <random>
+#include <thread>
 
+#include "concurrent_map.h"
+#include "concurrent_search_server.h"
+#include "index_file.h"
 #include "log_duration.h"
 #include "search_server.h"
 #include "process_queries.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "test_framework.h"
 
 using namespace std;
 
@@ -66,6 +77,37 @@ void Test_FT(const string_view mark, const SearchServer& search_server, const ve
 
 #define TEST_FT(policy) Test_FT("FT: " #policy, search_server, queries, execution::policy)
 
+// Пропускная способность FindTopDocuments с моделью ранжирования RankingModel
+template <typename RankingModel, typename ExecutionPolicy>
+void Test_RM(const string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto document : search_server.FindTopDocuments<RankingModel>(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << "Total relevance: " << total_relevance << endl;
+}
+
+#define TEST_RM(model, policy) Test_RM<model>("RM: " #model " " #policy, search_server, queries, execution::policy)
+
+// FindTopDocuments с отбором по рейтингу: лямбда-предикатом и DocumentAttributeFilter
+template <typename ExecutionPolicy, typename DocumentPredicate>
+void Test_AF(const string_view mark, const SearchServer& search_server, const vector<string>& queries,
+             ExecutionPolicy&& policy, DocumentPredicate document_predicate) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto document : search_server.FindTopDocuments(policy, query, document_predicate)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << "Total relevance: " << total_relevance << endl;
+}
+
+#define TEST_AF(policy, predicate) Test_AF("AF: " #policy " " #predicate, search_server, queries, execution::policy, predicate)
+
 template <typename QueriesProcessor>
 void Test_QP(const string_view mark, const QueriesProcessor processor, const SearchServer& search_server, const vector<string>& queries) {
     LOG_DURATION(mark);
@@ -87,6 +129,93 @@ void Test_RD(string_view mark, SearchServer search_server, ExecutionPolicy&& pol
 
 #define TEST_RD(policy) Test_RD("RD: " #policy, search_server, execution::policy)
 
+template <typename ExecutionPolicy>
+void Test_RDs(string_view mark, SearchServer search_server, ExecutionPolicy&& policy) {
+    const vector<int> ids(search_server.begin(), search_server.end());
+    LOG_DURATION(mark);
+    cout << search_server.GetDocumentCount() << "->";
+    search_server.RemoveDocuments(policy, ids);
+    cout << search_server.GetDocumentCount() << endl;
+}
+
+#define TEST_RDS(policy) Test_RDs("RDs: " #policy, search_server, execution::policy)
+
+
+// Загрузка documents по одному AddDocument - база для сравнения с TEST_AD
+void Test_AD1(const vector<string>& stop_words, const vector<string>& documents) {
+    SearchServer search_server(stop_words);
+    {
+        LOG_DURATION("AD: AddDocument"s);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    }
+    cout << search_server.GetDocumentCount() << " documents" << endl;
+}
+
+#define TEST_AD1 Test_AD1({dictionary[0]}, documents)
+
+// Загрузка documents пачками AddDocuments по batch_size документов: начиная со второй пачки
+// posting lists пачки дописываются к уже непустым общим, обычно после неполного блока
+template <typename ExecutionPolicy>
+void Test_AD(string_view mark, const vector<string>& stop_words, const vector<string>& documents,
+             size_t batch_size, ExecutionPolicy&& policy) {
+    vector<vector<NewDocument>> batches;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (i % batch_size == 0) {
+            batches.emplace_back();
+        }
+        batches.back().push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    SearchServer search_server(stop_words);
+    {
+        LOG_DURATION(mark);
+        for (const vector<NewDocument>& batch : batches) {
+            search_server.AddDocuments(policy, batch);
+        }
+    }
+    cout << search_server.GetDocumentCount() << " documents" << endl;
+}
+
+#define TEST_AD(policy, batch_size) Test_AD("AD: " #policy " by " #batch_size, {dictionary[0]}, documents, batch_size, execution::policy)
+
+
+// Запуск с индексом из файла: открытие с проверкой контрольной суммы и без неё
+// против построения того же индекса добавлением документов
+void Test_OI(const vector<string>& stop_words, const vector<string>& documents) {
+    const string path = (filesystem::temp_directory_path() / "search_server_bench.idx").string();
+    {
+        SearchServer search_server(stop_words);
+        LOG_DURATION("OI: AddDocument"s);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        search_server.SaveIndex(path);
+    }
+    {
+        LOG_DURATION("OI: OpenIndex verified"s);
+        const SearchServer search_server = SearchServer::OpenIndex(path);
+        cout << search_server.GetDocumentCount() << " documents" << endl;
+    }
+    {
+        LOG_DURATION("OI: OpenIndex unverified"s);
+        const SearchServer search_server = SearchServer::OpenIndex(path, false);
+        cout << search_server.GetDocumentCount() << " documents" << endl;
+    }
+    filesystem::remove(path);
+}
+
+#define TEST_OI Test_OI({dictionary[0]}, documents)
+
+
+template <typename ExecutionPolicy>
+void Test_DD(string_view mark, const SearchServer& search_server, const DuplicateDetector& detector, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    cout << detector.FindDuplicates(policy, search_server).size() << " duplicates" << endl;
+}
+
+#define TEST_DD(detector, policy) Test_DD("DD: " #detector " " #policy, search_server, detector, execution::policy)
+
 
 template <typename ExecutionPolicy>
 void Test_Mt(string_view mark, SearchServer search_server, const string& query, ExecutionPolicy&& policy) {
@@ -105,6 +234,656 @@ void Test_Mt(string_view mark, SearchServer search_server, const string& query,
 
 #define TEST_Mt(policy) Test_Mt("Mt: " #policy, search_server, query, execution::policy)
 
+
+// Тот же запрос ко всем документам одним вызовом MatchDocuments
+template <typename ExecutionPolicy>
+void Test_MDs(string_view mark, const SearchServer& search_server, const string& query, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    const SearchServer::MatchedDocuments matched = search_server.MatchDocuments(policy, query, search_server);
+    cout << "Match documents: " << matched.words.size() << endl;
+}
+
+#define TEST_MDS(policy) Test_MDs("MDs: " #policy, search_server, query, execution::policy)
+
+
+// Запросы через RequestQueue с распределением Ципфа (запрос ранга r - с весом 1 / r)
+// при кеше результатов на cache_capacity запросов
+void Test_QC(string_view mark, SearchServer search_server, const vector<string>& queries,
+             size_t cache_capacity, int request_count) {
+    search_server.SetQueryCacheCapacity(cache_capacity);
+    vector<double> weights(queries.size());
+    for (size_t rank = 0; rank < weights.size(); ++rank) {
+        weights[rank] = 1.0 / (rank + 1);
+    }
+    mt19937 generator;
+    discrete_distribution<size_t> query_distribution(weights.begin(), weights.end());
+    RequestQueue request_queue(search_server);
+
+    LOG_DURATION(mark);
+    for (int i = 0; i < request_count; ++i) {
+        request_queue.AddFindRequest(queries[query_distribution(generator)]);
+    }
+    const QueryCache::Stats stats = search_server.GetQueryCacheStats();
+    cout << "No result requests: " << request_queue.GetNoResultRequests()
+         << ", cache hits: " << stats.hits << ", misses: " << stats.misses << endl;
+}
+
+#define TEST_QC(cache_capacity) Test_QC("QC: " #cache_capacity, search_server, queries, cache_capacity, 1'000)
+
+
+// Конкурентная нагрузка на ConcurrentMap: operation_count операций делятся между
+// thread_count потоками, 90% чтений, 10% вставок и удалений по случайным ключам
+void Test_CM(string_view mark, int thread_count, int operation_count, int key_count) {
+    ConcurrentMap<int, int> map;
+    for (int key = 0; key < key_count; key += 2) {
+        map.Insert(key, key);
+    }
+    atomic<int64_t> found_count = 0;
+
+    LOG_DURATION(mark);
+    vector<thread> threads;
+    for (int thread_index = 0; thread_index < thread_count; ++thread_index) {
+        threads.emplace_back([&map, &found_count, thread_index, thread_count, operation_count, key_count] {
+            mt19937 generator(thread_index);
+            uniform_int_distribution<int> key_distribution(0, key_count - 1);
+            int64_t found = 0;
+            for (int i = thread_index; i < operation_count; i += thread_count) {
+                const int key = key_distribution(generator);
+                if (i % 20 == 0) {
+                    map[key].ref_to_value += 1;
+                } else if (i % 20 == 10) {
+                    map.Erase(key);
+                } else {
+                    found += map.Find(key).has_value();
+                }
+            }
+            found_count += found;
+        });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+}
+
+#define TEST_CM(thread_count) Test_CM("CM: " #thread_count " threads", thread_count, 4'000'000, 100'000)
+
+
+// Запросы к ConcurrentSearchServer, при with_ingest параллельно поток-писатель
+// непрерывно добавляет документы documents
+void Test_CS(string_view mark, bool with_ingest, const vector<string>& stop_words,
+             const vector<string>& documents, const vector<string>& queries) {
+    ConcurrentSearchServer search_server(stop_words);
+    const size_t initial_count = documents.size() / 2;
+    for (size_t i = 0; i < initial_count; ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    atomic<bool> done = false;
+    thread writer([&] {
+        for (size_t i = initial_count; with_ingest && !done && i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    });
+    {
+        LOG_DURATION(mark);
+        double total_relevance = 0;
+        for (const string_view query : queries) {
+            for (const auto& document : search_server.FindTopDocuments(query)) {
+                total_relevance += document.relevance;
+            }
+        }
+    }
+    done = true;
+    writer.join();
+}
+
+#define TEST_CS(with_ingest) Test_CS("CS: ingest " #with_ingest, with_ingest, {dictionary[0]}, documents, queries)
+
+
+//----Unit tests
+// Проверки поведения индекса на ASSERT из test_framework.h. Запускаются из main
+// перед замерами, при провале TestRunner завершает программу с кодом 1
+
+// Записи в порядке id независимо от порядка добавления, позиции и номера документов
+// сохраняются, SkipTo и удаление работают поверх границ блоков
+void TestPostingList() {
+    const uint32_t document_count = PostingList::BLOCK_SIZE * 3 + 17;
+    PostingList postings;
+    for (uint32_t i = 0; i < document_count; ++i) {
+        // Чётные id по возрастанию, затем нечётные вставки внутрь блоков
+        const uint32_t k = i < document_count / 2 ? 2 * i : 2 * (i - document_count / 2) + 1;
+        postings.Add(k * 3, k + 100, 1u << (k % 4), {k % 5, k % 5 + 2}, 2.0 / (k % 5 + 3));
+    }
+    ASSERT_EQUAL(postings.size(), document_count);
+
+    vector<uint32_t> positions;
+    int previous_id = -1;
+    uint32_t seen = 0;
+    for (auto it = postings.begin(); it != postings.end(); ++it) {
+        ASSERT(it->document_id > previous_id);
+        previous_id = it->document_id;
+        const uint32_t k = it->document_id / 3;
+        ASSERT_EQUAL(it->ordinal, k + 100);
+        ASSERT_EQUAL(it->count, 2u);
+        it.GetPositions(positions);
+        ASSERT_EQUAL(positions, (vector<uint32_t>{k % 5, k % 5 + 2}));
+        ++seen;
+    }
+    ASSERT_EQUAL(seen, document_count);
+
+    auto it = postings.begin();
+    it.SkipTo(301);
+    ASSERT_EQUAL(it->document_id, 303);
+    it.SkipTo(3 * 300);
+    ASSERT_EQUAL(it->document_id, 900);
+    it.SkipTo(numeric_limits<int>::max());
+    ASSERT(it == postings.end());
+
+    ASSERT(postings.Erase(900));
+    ASSERT(!postings.Erase(900));
+    ASSERT_EQUAL(postings.Erase(vector<int>{0, 1, 3, 6, 7}), 3u);
+    ASSERT_EQUAL(postings.size(), document_count - 4);
+    it = postings.begin();
+    ASSERT_EQUAL(it->document_id, 9);
+    it.SkipTo(900);
+    ASSERT_EQUAL(it->document_id, 903);
+
+    // Append переносит блоки и после неполного последнего блока; записи дописываются
+    // в последний перенесённый блок
+    PostingList head;
+    PostingList tail;
+    for (uint32_t i = 0; i < PostingList::BLOCK_SIZE + 5; ++i) {
+        head.Add(2 * i, i, 1, {i % 3}, 0.5);
+        tail.Add(1000 + 2 * i, i, 2, {i % 3, i % 3 + 1}, 0.5);
+    }
+    PostingList overlapping;
+    overlapping.Add(2, 0, 1, {0}, 0.5);
+    ASSERT(!head.Append(move(overlapping)));
+    ASSERT(head.Append(move(tail)));
+    head.Add(5000, 0, 1, {7}, 0.5);
+    head.Add(1, 0, 1, {7}, 0.5);
+    ASSERT_EQUAL(head.size(), 2 * (PostingList::BLOCK_SIZE + 5) + 2);
+    previous_id = -1;
+    for (auto it = head.begin(); it != head.end(); ++it) {
+        ASSERT(it->document_id > previous_id);
+        previous_id = it->document_id;
+        it.GetPositions(positions);
+        ASSERT_EQUAL(positions.size(), it->count);
+        if (it->document_id >= 1000 && it->document_id < 5000) {
+            ASSERT_EQUAL(it->count, 2u);
+            ASSERT_EQUAL(positions[0], (it->document_id - 1000) / 2 % 3);
+        }
+    }
+    ASSERT_EQUAL(previous_id, 5000);
+    it = head.begin();
+    it.SkipTo(1000 + 2 * PostingList::BLOCK_SIZE);
+    ASSERT_EQUAL(it->document_id, static_cast<int>(1000 + 2 * PostingList::BLOCK_SIZE));
+    ASSERT(head.Erase(1000));
+    ASSERT(head.Erase(5000));
+}
+
+// Id выдаются по порядку, копия и перемещённый словарь не пишут в чужие блоки арены
+void TestTermDictionary() {
+    TermDictionary dictionary;
+    ASSERT_EQUAL(dictionary.Intern("cat"sv), 0u);
+    ASSERT_EQUAL(dictionary.Intern("dog"sv), 1u);
+    ASSERT_EQUAL(dictionary.Intern("cat"sv), 0u);
+    ASSERT_EQUAL(dictionary.Find("bird"sv), TermDictionary::NO_TERM);
+
+    TermDictionary copy = dictionary;
+    ASSERT_EQUAL(copy.Intern("bird"sv), 2u);
+    ASSERT_EQUAL(dictionary.Find("bird"sv), TermDictionary::NO_TERM);
+
+    TermDictionary moved = std::move(dictionary);
+    ASSERT_EQUAL(dictionary.size(), 0u);
+    ASSERT_EQUAL(dictionary.Intern("fish"sv), 0u);
+    ASSERT_EQUAL(moved.Intern("rat"sv), 2u);
+    ASSERT_EQUAL(moved.GetTerm(0), "cat"sv);
+    ASSERT_EQUAL(moved.GetTerm(2), "rat"sv);
+    ASSERT_EQUAL(dictionary.GetTerm(0), "fish"sv);
+}
+
+// Номера и перебор id по возрастанию при вставках и удалениях вразнобой, на нескольких блоках id
+void TestDocumentOrdinals() {
+    mt19937 generator(22);
+    DocumentOrdinals ordinals;
+    map<int, DocumentOrdinals::Ordinal> expected;
+    const auto check = [&ordinals, &expected] {
+        ASSERT_EQUAL(ordinals.size(), expected.size());
+        vector<int> _expected_ids;
+        for (const auto& [document_id, ordinal] : expected) {
+            ASSERT_EQUAL(ordinals.Find(document_id), ordinal);
+            _expected_ids.push_back(document_id);
+        }
+        ASSERT_EQUAL(vector<int>(ordinals.begin(), ordinals.end()), _expected_ids);
+    };
+
+    vector<int> _ids(5 * DocumentOrdinals::ID_BLOCK_SIZE);
+    for (size_t i = 0; i < _ids.size(); ++i) {
+        _ids[i] = static_cast<int>(i) * 3;
+    }
+    shuffle(_ids.begin(), _ids.end(), generator);
+    for (const int document_id : _ids) {
+        expected[document_id] = ordinals.Add(document_id);
+    }
+    check();
+    ASSERT_EQUAL(*ordinals.LowerBound(301), 303);
+    ASSERT(ordinals.LowerBound(ordinals.GetLastId() + 1) == ordinals.end());
+
+    shuffle(_ids.begin(), _ids.end(), generator);
+    _ids.resize(_ids.size() * 3 / 4);
+    for (const int document_id : _ids) {
+        ordinals.Remove(document_id);
+        expected.erase(document_id);
+    }
+    check();
+
+    // Освобождённые номера выдаются снова, столбцы не растут
+    const DocumentOrdinals::Ordinal capacity = ordinals.GetCapacity();
+    for (int document_id = 1; document_id < 300; document_id += 3) {
+        expected[document_id] = ordinals.Add(document_id);
+    }
+    check();
+    ASSERT_EQUAL(ordinals.GetCapacity(), capacity);
+    ASSERT_EQUAL(ordinals.GetFirstId(), expected.begin()->first);
+    ASSERT_EQUAL(ordinals.GetLastId(), expected.rbegin()->first);
+
+    vector<int> removed;
+    for (const auto& [document_id, ordinal] : expected) {
+        if (document_id % 2 == 0) {
+            removed.push_back(document_id);
+        }
+    }
+    ordinals.Remove(removed);
+    for (const int document_id : removed) {
+        expected.erase(document_id);
+    }
+    check();
+}
+
+// Документы с равными релевантностью и рейтингом выдаются по возрастанию id
+// независимо от порядка добавления в кучу и способа вычисления запроса
+void TestTopDocumentsOrder() {
+    vector<Document> documents;
+    for (int id = 9; id >= 0; --id) {
+        documents.push_back({id, 0.5, id % 2});
+    }
+    documents.push_back({20, 0.9, 0});
+    const vector<Document> top = SelectTopDocuments(execution::seq, documents, 5);
+    ASSERT_EQUAL(top.size(), 5u);
+    ASSERT_EQUAL(top[0].id, 20);
+    ASSERT_EQUAL(top[1].id, 1);
+    ASSERT_EQUAL(top[2].id, 3);
+    ASSERT_EQUAL(top[3].id, 5);
+    ASSERT_EQUAL(top[4].id, 7);
+
+    SearchServer search_server("and with"s);
+    int id = 0;
+    for (const string& text : {"white cat and yellow hat"s, "curly cat curly tail"s,
+                               "nasty dog with big eyes"s, "nasty pigeon john"s}) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+    for (const auto evaluation : {SearchServer::QueryEvaluation::WAND, SearchServer::QueryEvaluation::EXHAUSTIVE}) {
+        search_server.SetQueryEvaluation(evaluation);
+        for (const auto& result : {search_server.FindTopDocuments(execution::seq, "curly nasty cat"s),
+                                   search_server.FindTopDocuments(execution::par, "curly nasty cat"s)}) {
+            vector<int> ids;
+            for (const Document& document : result) {
+                ids.push_back(document.id);
+            }
+            ASSERT_EQUAL(ids, (vector<int>{2, 4, 1, 3}));
+        }
+    }
+}
+
+void AssertSameDocuments(const vector<Document>& lhs, const vector<Document>& rhs, const string& hint) {
+    AssertEqual(lhs.size(), rhs.size(), hint);
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        AssertEqual(lhs[i].id, rhs[i].id, hint);
+        AssertEqual(lhs[i].relevance, rhs[i].relevance, hint);
+        AssertEqual(lhs[i].rating, rhs[i].rating, hint);
+    }
+}
+
+// WAND отсекает документы, но выдаёт ровно то же, что полный перебор: на маленьком
+// словаре много равных релевантностей, рейтинги из узкого диапазона
+void TestWandMatchesExhaustive() {
+    mt19937 generator(4);
+    const vector<string> dictionary = GenerateDictionary(generator, 60, 3);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < 4000; ++i) {
+        const int id = i < 3000 ? i : 3000 + 97 * i;
+        search_server.AddDocument(id, GenerateQuery(generator, dictionary, 1 + i % 12),
+                                  static_cast<DocumentStatus>(i / 700 % 4), {static_cast<int>(generator() % 4)});
+    }
+    for (int id = 0; id < 3000; id += 7) {
+        search_server.RemoveDocument(id);
+    }
+    SearchServer exhaustive_server = search_server;
+    exhaustive_server.SetQueryEvaluation(SearchServer::QueryEvaluation::EXHAUSTIVE);
+
+    const auto rating_predicate = [](int, DocumentStatus, int rating) { return rating >= 2; };
+    for (int i = 0; i < 300; ++i) {
+        const string query = GenerateQuery(generator, dictionary, 1 + i % 5, i % 3 == 0 ? 0.2 : 0.0);
+        const size_t top_count = i % 2 == 0 ? MAX_RESULT_DOCUMENT_COUNT : 40;
+        const DocumentAttributeFilter status_filter{static_cast<DocumentStatus>(i % 4)};
+        AssertSameDocuments(search_server.FindTopDocuments(query, DocumentAttributeFilter{}, top_count),
+                            exhaustive_server.FindTopDocuments(query, DocumentAttributeFilter{}, top_count), query);
+        AssertSameDocuments(search_server.FindTopDocuments(query, status_filter, top_count),
+                            exhaustive_server.FindTopDocuments(query, status_filter, top_count), query);
+        AssertSameDocuments(search_server.FindTopDocuments<Bm25Ranking>(query, rating_predicate, top_count),
+                            exhaustive_server.FindTopDocuments<Bm25Ranking>(query, rating_predicate, top_count),
+                            query);
+    }
+}
+
+template <typename ExecutionPolicy>
+set<int> FindDocumentIds(const SearchServer& search_server, ExecutionPolicy&& policy, string_view query) {
+    set<int> ids;
+    for (const Document& document : search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, 100)) {
+        ids.insert(document.id);
+    }
+    return ids;
+}
+
+// Фразы, AND, обязательные и минус-слова: одинаково при seq и par
+void TestQueryOperators() {
+    SearchServer search_server("and with"s);
+    int id = 0;
+    for (const string& text : {"white cat and yellow hat"s, "curly cat curly tail"s, "nasty dog with big eyes"s,
+                               "nasty pigeon john"s, "big white cat with yellow eyes"s}) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+    const auto check = [&search_server](string_view query, const set<int>& expected) {
+        AssertEqual(FindDocumentIds(search_server, execution::seq, query), expected, string(query));
+        AssertEqual(FindDocumentIds(search_server, execution::par, query), expected, string(query));
+    };
+    // Фраза совпала: слова подряд, стоп-слово внутри фразы не учитывается
+    check("\"yellow hat\""sv, {1});
+    check("\"white and cat\""sv, {1, 5});
+    check("\"big eyes\" john"sv, {3});
+    // Фраза не совпала: слова есть, но не подряд или в другом порядке
+    check("\"hat yellow\""sv, {});
+    check("\"white yellow\""sv, {});
+    check("\"cat tail\""sv, {});
+    // AND
+    check("cat AND yellow"sv, {1, 5});
+    check("cat AND nasty"sv, {});
+    check("cat AND yellow AND hat"sv, {1});
+    // Обязательные и минус-слова
+    check("+cat -curly white"sv, {1, 5});
+    check("+nasty -pigeon"sv, {3});
+    check("+cat +eyes"sv, {5});
+    check("+cat -cat"sv, {});
+    check("+fish cat"sv, {});
+    check("curly nasty cat"sv, {1, 2, 3, 4, 5});
+    // Повторы слов
+    check("+cat +cat cat AND yellow"sv, {1, 5});
+    check("+fish +fish cat"sv, {});
+
+    // MatchDocument проверяет те же условия
+    const auto matched_words = [&search_server](string_view query, int document_id) {
+        return get<0>(search_server.MatchDocument(query, document_id));
+    };
+    ASSERT_EQUAL(matched_words("\"yellow hat\""sv, 1), (vector<string_view>{"hat"sv, "yellow"sv}));
+    ASSERT(matched_words("\"hat yellow\""sv, 1).empty());
+    ASSERT_EQUAL(matched_words("cat AND yellow"sv, 5), (vector<string_view>{"cat"sv, "yellow"sv}));
+    ASSERT(matched_words("cat AND yellow"sv, 2).empty());
+    ASSERT(matched_words("+cat -curly"sv, 2).empty());
+    ASSERT_EQUAL(matched_words("+cat -curly"sv, 1), (vector<string_view>{"cat"sv}));
+    ASSERT_EQUAL(matched_words("yellow cat -curly cat yellow"sv, 5), (vector<string_view>{"cat"sv, "yellow"sv}));
+
+    ASSERT_THROWS(search_server.FindTopDocuments("-\"yellow hat\""sv), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("\"yellow hat"sv), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("cat AND"sv), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("ca\"t"sv), invalid_argument);
+}
+
+void AssertSameIndex(const SearchServer& lhs, const SearchServer& rhs, mt19937& generator,
+                     const vector<string>& dictionary) {
+    ASSERT(equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()));
+    // Id новых слов зависят от порядка добавления документов, поэтому слова сравниваются как словари
+    for (const int document_id : lhs) {
+        const map<string_view, double> lhs_frequencies = lhs.GetWordFrequencies(document_id);
+        ASSERT_EQUAL(lhs_frequencies, rhs.GetWordFrequencies(document_id));
+        const TermFrequencies term_frequencies = lhs.GetTermFrequencies(document_id);
+        ASSERT_EQUAL(term_frequencies.size(), lhs_frequencies.size());
+        for (const auto& [word, frequency] : term_frequencies) {
+            ASSERT_EQUAL(term_frequencies.at(word), lhs_frequencies.at(word));
+            ASSERT_EQUAL(term_frequencies.at(word), frequency);
+        }
+    }
+    for (int i = 0; i < 30; ++i) {
+        string query = GenerateQuery(generator, dictionary, 1 + i % 4, 0.2);
+        if (i % 5 == 0) {
+            query += " \""s + dictionary[generator() % dictionary.size()] + " "s
+                     + dictionary[generator() % dictionary.size()] + "\""s;
+        }
+        AssertSameDocuments(lhs.FindTopDocuments(execution::seq, query),
+                            rhs.FindTopDocuments(execution::seq, query), query);
+        AssertSameDocuments(lhs.FindTopDocuments<Bm25Ranking>(execution::par, query, DocumentStatus::BANNED),
+                            rhs.FindTopDocuments<Bm25Ranking>(execution::par, query, DocumentStatus::BANNED), query);
+    }
+}
+
+// Пачки AddDocuments - то же, что AddDocument по одному: в пустой индекс, после неполных
+// блоков posting lists, с id меньше уже добавленных; при ошибке индекс не изменяется
+template <typename ExecutionPolicy>
+void CheckAddDocuments(ExecutionPolicy&& policy) {
+    mt19937 generator(11);
+    const vector<string> dictionary = GenerateDictionary(generator, 400, 6);
+    vector<string> texts;
+    vector<NewDocument> documents;
+    for (int i = 0; i < 3000; ++i) {
+        texts.push_back(GenerateQuery(generator, dictionary, 1 + i % 40));
+    }
+    for (int i = 0; i < 3000; ++i) {
+        // Третья пачка - нечётные id между id первых двух
+        const int id = i < 2000 ? 2 * i : 2 * (i - 2000) * 3 + 1;
+        documents.push_back({id, texts[i], static_cast<DocumentStatus>(i % 4), {static_cast<int>(generator() % 10)}});
+    }
+    shuffle(documents.begin(), documents.begin() + 1000, generator);
+
+    SearchServer expected(dictionary[0]);
+    SearchServer batched(dictionary[0]);
+    for (int batch = 0; batch < 3; ++batch) {
+        const vector<NewDocument> batch_documents(documents.begin() + batch * 1000,
+                                                  documents.begin() + (batch + 1) * 1000);
+        // Пачка разбирается по возрастанию id: в том же порядке новые слова получают id,
+        // от которого зависит порядок суммирования релевантности
+        vector<NewDocument> sorted_documents = batch_documents;
+        sort(sorted_documents.begin(), sorted_documents.end(),
+             [](const NewDocument& lhs, const NewDocument& rhs) { return lhs.id < rhs.id; });
+        for (const NewDocument& document : sorted_documents) {
+            expected.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        batched.AddDocuments(policy, batch_documents);
+        AssertSameIndex(expected, batched, generator, dictionary);
+    }
+
+    const vector<NewDocument> bad_documents{{100'000, "new words here"s, DocumentStatus::ACTUAL, {1}},
+                                            {100'001, "bad\x01word"s, DocumentStatus::ACTUAL, {1}}};
+    ASSERT_THROWS(batched.AddDocuments(policy, bad_documents), invalid_argument);
+    const vector<NewDocument> repeated_documents{{100'000, "new words"s, DocumentStatus::ACTUAL, {1}},
+                                                 {documents[5].id, "new words"s, DocumentStatus::ACTUAL, {1}}};
+    ASSERT_THROWS(batched.AddDocuments(policy, repeated_documents), invalid_argument);
+    AssertSameIndex(expected, batched, generator, dictionary);
+    ASSERT(batched.FindTopDocuments("new words"s).empty());
+}
+
+void TestAddDocuments() {
+    CheckAddDocuments(execution::seq);
+    CheckAddDocuments(execution::par);
+}
+
+// Открытый индекс отвечает на запросы так же, как сохранённый, и остаётся изменяемым;
+// испорченная таблица блоков и обрезанный файл отвергаются и без контрольной суммы
+void TestSaveOpenIndex() {
+    mt19937 generator(9);
+    const vector<string> dictionary = GenerateDictionary(generator, 300, 6);
+    SearchServer search_server(vector<string>{dictionary[0], dictionary[1]});
+    for (int i = 0; i < 2000; ++i) {
+        search_server.AddDocument(3 * i + i % 2, GenerateQuery(generator, dictionary, 1 + i % 30),
+                                  static_cast<DocumentStatus>(i % 4), {static_cast<int>(generator() % 10) - 3});
+    }
+    for (int i = 0; i < 2000; i += 5) {
+        search_server.RemoveDocument(3 * i + i % 2);
+    }
+    const string path = (filesystem::temp_directory_path() / "search_server_test.idx").string();
+    search_server.SaveIndex(path);
+
+    for (const bool verify_checksum : {true, false}) {
+        SearchServer opened = SearchServer::OpenIndex(path, verify_checksum);
+        ASSERT_EQUAL(opened.GetDocumentCount(), search_server.GetDocumentCount());
+        ASSERT(equal(opened.begin(), opened.end(), search_server.begin(), search_server.end()));
+        for (int i = 0; i < 50; ++i) {
+            string query = GenerateQuery(generator, dictionary, 1 + i % 4, 0.2);
+            if (i % 5 == 0) {
+                query += " \""s + dictionary[generator() % dictionary.size()] + " "s
+                         + dictionary[generator() % dictionary.size()] + "\""s;
+            }
+            AssertSameDocuments(opened.FindTopDocuments(execution::seq, query),
+                                search_server.FindTopDocuments(execution::seq, query), query);
+            AssertSameDocuments(opened.FindTopDocuments<Bm25Ranking>(execution::par, query, DocumentStatus::BANNED),
+                                search_server.FindTopDocuments<Bm25Ranking>(execution::par, query,
+                                                                            DocumentStatus::BANNED),
+                                query);
+            const int document_id = *next(search_server.begin(), generator() % search_server.GetDocumentCount());
+            const auto [opened_words, opened_status] = opened.MatchDocument(query, document_id);
+            const auto [words, status] = search_server.MatchDocument(query, document_id);
+            AssertEqual(opened_words, words, query);
+            Assert(opened_status == status, query);
+        }
+
+        // Изменения открытого индекса копируют затронутые списки из отображённой памяти
+        SearchServer changed = search_server;
+        for (SearchServer* server : {&opened, &changed}) {
+            server->AddDocument(100'000, dictionary[5] + " "s + dictionary[6], DocumentStatus::ACTUAL, {7});
+            server->RemoveDocument(4);
+        }
+        const string query = dictionary[5] + " "s + dictionary[7];
+        AssertSameDocuments(opened.FindTopDocuments(query), changed.FindTopDocuments(query), query);
+    }
+
+    // Первый блок первого непустого списка объявляет больше записей, чем блок может содержать
+    {
+        IndexFileHeader header;
+        IndexPostingRecord record;
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        uint64_t record_offset = header.postings_offset + sizeof(uint64_t);
+        do {
+            file.seekg(record_offset);
+            file.read(reinterpret_cast<char*>(&record), sizeof(record));
+            record_offset += sizeof(record);
+        } while (record.block_count == 0);
+        const uint32_t size = PostingList::BLOCK_SIZE + 1;
+        file.seekp(record.blocks_offset + offsetof(PostingList::Block, size));
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+    ASSERT_THROWS(SearchServer::OpenIndex(path, false), runtime_error);
+    ASSERT_THROWS(SearchServer::OpenIndex(path), runtime_error);
+
+    search_server.SaveIndex(path);
+    filesystem::resize_file(path, filesystem::file_size(path) - 16);
+    ASSERT_THROWS(SearchServer::OpenIndex(path, false), runtime_error);
+    filesystem::remove(path);
+}
+
+template <typename ExecutionPolicy>
+vector<int> FindDuplicateIds(ExecutionPolicy&& policy, const SearchServer& search_server,
+                             const DuplicateDetector& detector) {
+    return detector.FindDuplicates(policy, search_server);
+}
+
+// Точные и почти-дубликаты; большой кластер почти-дубликатов сводится к одному документу
+void TestDuplicateDetector() {
+    SearchServer search_server("and with"s);
+    int id = 0;
+    for (const string& text : {"funny pet and nasty rat"s, "funny pet with curly hair"s, "funny pet and nasty rat"s,
+                               "pet with rat and rat and rat"s, "nasty rat with curly hair"s,
+                               "funny pet with curly hair and nasty rat"s, "funny funny pet with curly curly hair"s}) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+    ASSERT_EQUAL(FindDuplicateIds(execution::seq, search_server, DuplicateDetector()), (vector<int>{3, 7}));
+    ASSERT_EQUAL(FindDuplicateIds(execution::par, search_server, DuplicateDetector(0.5)),
+                 (vector<int>{3, 4, 6, 7}));
+
+    // Кластер: общие 50 слов и по одному своему слову (сходство 50/52), вперемешку
+    // с несвязанными документами
+    mt19937 generator(19);
+    const vector<string> dictionary = GenerateDictionary(generator, 5000, 12);
+    const string base = GenerateQuery(generator, dictionary, 50);
+    SearchServer big_server("and with"s);
+    vector<int> expected;
+    for (int i = 0; i < 3000; ++i) {
+        if (i % 3 == 0) {
+            big_server.AddDocument(i, GenerateQuery(generator, dictionary, 40), DocumentStatus::ACTUAL, {1});
+            continue;
+        }
+        big_server.AddDocument(i, base + " "s + to_string(i), DocumentStatus::ACTUAL, {1});
+        if (i > 1) {
+            expected.push_back(i);
+        }
+    }
+    ASSERT_EQUAL(FindDuplicateIds(execution::seq, big_server, DuplicateDetector(0.9)), expected);
+    ASSERT_EQUAL(FindDuplicateIds(execution::par, big_server, DuplicateDetector(0.9)), expected);
+}
+
+// Удаления из замороженных сегментов ConcurrentSearchServer, в том числе с далёкими id,
+// дают ту же выдачу и статистику, что SearchServer
+void TestConcurrentRemoveDocument() {
+    mt19937 generator(8);
+    const vector<string> dictionary = GenerateDictionary(generator, 200, 6);
+    ConcurrentSearchServer concurrent_server("and with"s);
+    SearchServer search_server("and with"s);
+    vector<int> ids;
+    for (int i = 0; i < 300; ++i) {
+        ids.push_back(i % 50 == 0 ? 2'000'000'000 - i : i * 3);
+    }
+    for (const int id : ids) {
+        const string text = GenerateQuery(generator, dictionary, 10);
+        concurrent_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+    shuffle(ids.begin(), ids.end(), generator);
+    for (size_t i = 0; i < ids.size(); i += 2) {
+        concurrent_server.RemoveDocument(ids[i]);
+        search_server.RemoveDocument(ids[i]);
+    }
+    ASSERT_EQUAL(concurrent_server.GetDocumentCount(), search_server.GetDocumentCount());
+    for (int i = 0; i < 50; ++i) {
+        const string query = GenerateQuery(generator, dictionary, 3);
+        const vector<Document> expected = search_server.FindTopDocuments(query);
+        const vector<Document> found = concurrent_server.FindTopDocuments(query);
+        ASSERT_EQUAL(found.size(), expected.size());
+        for (size_t j = 0; j < found.size(); ++j) {
+            ASSERT_EQUAL(found[j].id, expected[j].id);
+            ASSERT(abs(found[j].relevance - expected[j].relevance) < 1e-9);
+        }
+    }
+    bool removed_twice = false;
+    try {
+        concurrent_server.RemoveDocument(ids[0]);
+    } catch (const out_of_range&) {
+        removed_twice = true;
+    }
+    ASSERT(removed_twice);
+}
+
+void TestSearchServer() {
+    TestRunner tr;
+    RUN_TEST(tr, TestPostingList);
+    RUN_TEST(tr, TestTermDictionary);
+    RUN_TEST(tr, TestDocumentOrdinals);
+    RUN_TEST(tr, TestTopDocumentsOrder);
+    RUN_TEST(tr, TestWandMatchesExhaustive);
+    RUN_TEST(tr, TestQueryOperators);
+    RUN_TEST(tr, TestAddDocuments);
+    RUN_TEST(tr, TestSaveOpenIndex);
+    RUN_TEST(tr, TestDuplicateDetector);
+    RUN_TEST(tr, TestConcurrentRemoveDocument);
+}
+
 /*
     if (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
 
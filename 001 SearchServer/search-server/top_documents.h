@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "document.h"
+
+const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const double MIN_ACCURACY = 1e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной (с точностью MIN_ACCURACY) - по убыванию
+// рейтинга, при равном рейтинге - по возрастанию id. Последнее правило делает выдачу
+// не зависящей от порядка, в котором документы попадают в кучу, и сохраняет порядок
+// полной сортировки документов, перебираемых по возрастанию id
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= MIN_ACCURACY) {
+        return lhs.relevance > rhs.relevance;
+    }
+    return lhs.rating > rhs.rating || (lhs.rating == rhs.rating && lhs.id < rhs.id);
+}
+
+// Ограниченная куча из top_count лучших документов, в вершине - худший из них
+class TopDocuments
+{
+public:
+    explicit TopDocuments(size_t top_count)
+        : top_count_(top_count)
+    {
+        _heap_.reserve(top_count);
+    }
+
+    void Push(const Document& document) {
+        if (_heap_.size() < top_count_) {
+            _heap_.push_back(document);
+            std::push_heap(_heap_.begin(), _heap_.end(), IsMoreRelevant);
+        } else if (top_count_ > 0 && IsMoreRelevant(document, _heap_.front())) {
+            std::pop_heap(_heap_.begin(), _heap_.end(), IsMoreRelevant);
+            _heap_.back() = document;
+            std::push_heap(_heap_.begin(), _heap_.end(), IsMoreRelevant);
+        }
+    }
+
+    void Merge(const TopDocuments& other) {
+        for (const Document& document : other._heap_) {
+            Push(document);
+        }
+    }
+
+    bool IsFull() const {
+        return _heap_.size() == top_count_;
+    }
+
+    // Худший из отобранных документов, куча должна быть непустой
+    const Document& Worst() const {
+        return _heap_.front();
+    }
+
+    // Отобранные документы от лучшего к худшему
+    std::vector<Document> Extract() && {
+        std::sort_heap(_heap_.begin(), _heap_.end(), IsMoreRelevant);
+        return std::move(_heap_);
+    }
+
+private:
+    size_t top_count_;
+    std::vector<Document> _heap_;
+};
+
+// Частичный отбор top_count лучших документов вместо полной сортировки.
+// В параллельной версии каждый поток заполняет свою кучу, затем кучи сливаются.
+template <typename ExecutionPolicy>
+std::vector<Document>
+SelectTopDocuments(ExecutionPolicy&& policy, const std::vector<Document>& documents, size_t top_count) {
+
+    static constexpr size_t MIN_PART_LENGTH = 4096;    // меньшие части дешевле обработать одним потоком
+    const size_t part_count = std::max<size_t>(
+                                  1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                      documents.size() / MIN_PART_LENGTH));
+
+    if (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy> || part_count == 1) {
+        TopDocuments top(top_count);
+        for (const Document& document : documents) {
+            top.Push(document);
+        }
+        return std::move(top).Extract();
+    }
+
+    const size_t part_length = (documents.size() + part_count - 1) / part_count;
+    std::vector<TopDocuments> tops(part_count, TopDocuments(top_count));
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+    std::for_each(policy,
+                  parts.begin(), parts.end(),
+                  [&documents, &tops, part_length](const size_t part) {
+                      const size_t first = std::min(part * part_length, documents.size());
+                      const size_t last = std::min(first + part_length, documents.size());
+                      for (size_t i = first; i < last; ++i) {
+                          tops[part].Push(documents[i]);
+                      }
+    });
+    TopDocuments result(top_count);
+    for (const TopDocuments& top : tops) {
+        result.Merge(top);
+    }
+    return std::move(result).Extract();
+}